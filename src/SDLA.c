@@ -101,6 +101,35 @@ void SDLA_Init(SDL_Window **window, SDL_Renderer **renderer, char *window_name,
 }
 
 
+// Enables or disables vsync. Returns 0 on success, -1 if not supported (SDL < 2.0.18, or by the renderer).
+int SDLA_SetVSync(int enabled)
+{
+	if (!RenderingInit)
+		SDLA_ExitWithError("SDLA's rendering subsystem is not initialized.");
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	return SDL_RenderSetVSync(Renderer, enabled) == 0 ? 0 : -1;
+#else
+	return -1;
+#endif
+}
+
+
+// Returns the refresh rate of the display the window is on, or 0 if unknown.
+int SDLA_GetRefreshRate(void)
+{
+	if (!RenderingInit)
+		SDLA_ExitWithError("SDLA's rendering subsystem is not initialized.");
+
+	SDL_DisplayMode mode;
+
+	if (SDL_GetWindowDisplayMode(Window, &mode) != 0)
+		return 0;
+
+	return mode.refresh_rate;
+}
+
+
 // Initialize the text input subsystem of SDLA. Returns the string to be filled with text input.
 // That string has to be freed by the user upon exiting.
 char* SDLA_InitTextInput(int text_input_length)
@@ -216,6 +245,107 @@ SDL_Texture* SDLA_CreateTextTexture(TTF_Font *font, SDL_Color *color, char *text
 }
 
 
+// Creates a fully transparent texture of format SDL_PIXELFORMAT_ARGB8888, with blending enabled.
+// Parts of it can then be filled with SDLA_UpdateTextTexture(). Useful for building atlases.
+SDL_Texture* SDLA_CreateBlankTexture(int width, int height)
+{
+	SDL_Texture *texture = SDL_CreateTexture(Renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, width, height);
+
+	if (texture == NULL)
+		SDLA_ExitWithError("Impossible to create the texture.");
+
+	if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) != 0)
+		SDLA_ExitWithError("Impossible to set the texture blend mode.");
+
+	SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+
+	if (surface == NULL)
+		SDLA_ExitWithError("Impossible to create the surface.");
+
+	if (SDL_UpdateTexture(texture, NULL, surface -> pixels, surface -> pitch) != 0)
+		SDLA_ExitWithError("Impossible to update the texture.");
+
+	SDL_FreeSurface(surface);
+
+	return texture;
+}
+
+
+// Creates a texture which can be used as a render target, with SDL_SetRenderTarget().
+SDL_Texture* SDLA_CreateTargetTexture(int width, int height)
+{
+	SDL_Texture *texture = SDL_CreateTexture(Renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+
+	if (texture == NULL)
+		SDLA_ExitWithError("Impossible to create the texture.");
+
+	return texture;
+}
+
+
+// Copies the surface in the given area of a texture created by SDLA_CreateBlankTexture(). The rest of
+// the area is made transparent, and the surface is clipped if too big. Returns the width of the copied part.
+static int updateTextureArea(SDL_Texture *texture, SDL_Rect *area, SDL_Surface *surface)
+{
+	// Transparent pixels:
+	SDL_Surface *area_surface = SDL_CreateRGBSurfaceWithFormat(0, area -> w, area -> h, 32, SDL_PIXELFORMAT_ARGB8888);
+
+	if (area_surface == NULL)
+		SDLA_ExitWithError("Impossible to create the surface.");
+
+	int width = 0;
+
+	if (surface != NULL)
+	{
+		// Copying the pixels as they are, alpha channel included:
+		SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+
+		if (SDL_BlitSurface(surface, NULL, area_surface, NULL) != 0)
+			SDLA_ExitWithError("Impossible to blit the surface.");
+
+		width = Min(surface -> w, area -> w);
+	}
+
+	if (SDL_UpdateTexture(texture, area, area_surface -> pixels, area_surface -> pitch) != 0)
+		SDLA_ExitWithError("Impossible to update the texture.");
+
+	SDL_FreeSurface(area_surface);
+
+	return width;
+}
+
+
+// Renders the text in the given area of a texture created by SDLA_CreateBlankTexture(). The rest of
+// the area is made transparent, and the text is clipped if too big. Returns the width of the drawn text.
+int SDLA_UpdateTextTexture(SDL_Texture *texture, SDL_Rect *area, TTF_Font *font, SDL_Color *color, char *text)
+{
+	if (font == NULL)
+		SDLA_ExitWithError("Font not loaded.");
+
+	if (color == NULL)
+		SDLA_ExitWithError("Color not set.");
+
+	if (text == NULL || text[0] == '\0')
+		return updateTextureArea(texture, area, NULL);
+
+	SDL_Surface *surface;
+
+	if (FontAliasing == SDLA_BLENDED)
+		surface = TTF_RenderText_Blended(font, text, *color);
+	else
+		surface = TTF_RenderText_Solid(font, text, *color);
+
+	if (surface == NULL)
+		SDLA_ExitWithError("Impossible to create the surface.");
+
+	int width = updateTextureArea(texture, area, surface);
+
+	SDL_FreeSurface(surface);
+
+	return width;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////
 // Drawing:
 ////////////////////////////////////////////////////////////////////////////////////
@@ -386,8 +516,70 @@ void SDLA_SetTextInputContent(char *text_input, char *new_content)
 // This needs a SDLA_Init() call in order to work.
 
 
-// Cache characters (from ch_min to ch_max) of the given font as separated textures,
-// in order to draw them dynamically and efficiently.
+// Location of the given character cell in the atlas:
+static SDL_Rect glyphCell(CachedFont *cached_font, char ch)
+{
+	int index = ch - cached_font -> Ch_min;
+
+	SDL_Rect cell = {(index % SDLA_ATLAS_COLUMNS) * cached_font -> CellWidth,
+		(index / SDLA_ATLAS_COLUMNS) * cached_font -> Height, cached_font -> CellWidth, cached_font -> Height};
+
+	return cell;
+}
+
+
+// Returns the glyph of the given character, loading its metrics if needed. NULL if not supported.
+static Glyph* getGlyphMetrics(CachedFont *cached_font, char ch)
+{
+	if (ch < cached_font -> Ch_min || ch > cached_font -> Ch_max)
+		return NULL;
+
+	Glyph *glyph = cached_font -> Table + ch - cached_font -> Ch_min;
+
+	if (!(glyph -> Loaded & SDLA_GLYPH_METRICS))
+	{
+		if (TTF_GlyphMetrics(cached_font -> Font, ch, &(glyph -> xMin), &(glyph -> xMax), NULL, NULL, NULL) == -1)
+			SDLA_ExitWithError("Impossible to find the glyphe size.");
+
+		glyph -> Loaded |= SDLA_GLYPH_METRICS;
+	}
+
+	return glyph;
+}
+
+
+// Returns the glyph of the given character, rendering it in the atlas if needed. NULL if not supported.
+static Glyph* getGlyph(CachedFont *cached_font, char ch)
+{
+	Glyph *glyph = getGlyphMetrics(cached_font, ch);
+
+	if (glyph == NULL || glyph -> Loaded & SDLA_GLYPH_RENDERED)
+		return glyph;
+
+	SDL_Surface *surface;
+
+	if (FontAliasing == SDLA_BLENDED)
+		surface = TTF_RenderGlyph_Blended(cached_font -> Font, ch, cached_font -> Color);
+	else
+		surface = TTF_RenderGlyph_Solid(cached_font -> Font, ch, cached_font -> Color);
+
+	if (surface == NULL)
+		SDLA_ExitWithError("Impossible to create the surface.");
+
+	glyph -> Rect = glyphCell(cached_font, ch);
+	glyph -> Rect.w = updateTextureArea(cached_font -> Atlas, &(glyph -> Rect), surface);
+	glyph -> Rect.h = Min(surface -> h, glyph -> Rect.h);
+
+	SDL_FreeSurface(surface);
+
+	glyph -> Loaded |= SDLA_GLYPH_RENDERED;
+
+	return glyph;
+}
+
+
+// Cache characters (from ch_min to ch_max) of the given font in a single atlas texture, in order to
+// draw them dynamically and efficiently. Glyphs are only rendered in the atlas when first drawn.
 CachedFont* SDLA_CachingFontByRange(char *font_name, short size, SDL_Color *color, char ch_min, char ch_max)
 {
 	if (color == NULL)
@@ -403,10 +595,16 @@ CachedFont* SDLA_CachingFontByRange(char *font_name, short size, SDL_Color *colo
 
 	CachedFont *cache = (CachedFont*) calloc(1, sizeof(CachedFont));
 
+	if (cache == NULL)
+		SDLA_ExitWithError("Impossible to allocate enough memory for 'cache'.");
+
 	cache -> Size = size;
 	cache -> Height = TTF_FontHeight(font);
 	cache -> Ch_min = ch_min;
 	cache -> Ch_max = ch_max;
+	cache -> Font = font; // Kept open for rendering glyphs lazily.
+	cache -> Color = *color;
+	cache -> CellWidth = 2 * size; // Wide enough for any glyph of the font.
 
 	int number = ch_max - ch_min + 1;
 
@@ -415,45 +613,75 @@ CachedFont* SDLA_CachingFontByRange(char *font_name, short size, SDL_Color *colo
 	if (cache -> Table == NULL)
 		SDLA_ExitWithError("Impossible to allocate enough memory for 'cache -> Table'.");
 
-	for (int i = 0; i < number; ++i)
-	{
-		SDL_Surface *surface;
+	int rows = (number + SDLA_ATLAS_COLUMNS - 1) / SDLA_ATLAS_COLUMNS;
 
-		if (FontAliasing == SDLA_BLENDED)
-			surface = TTF_RenderGlyph_Blended(font, i + ch_min, *color);
-		else
-			surface = TTF_RenderGlyph_Solid(font, i + ch_min, *color);
+	cache -> AtlasWidth = SDLA_ATLAS_COLUMNS * cache -> CellWidth;
+	cache -> AtlasHeight = rows * cache -> Height;
+	cache -> Atlas = SDLA_CreateBlankTexture(cache -> AtlasWidth, cache -> AtlasHeight);
+
+	return cache;
+}
 
-		if (surface == NULL)
-			SDLA_ExitWithError("Impossible to create the surface.");
 
-		Glyph *glyph = cache -> Table + i;
+// Cache all supported characters of the given font in a single atlas texture.
+CachedFont* SDLA_CachingFontAll(char *font_name, short size, SDL_Color *color)
+{
+	return SDLA_CachingFontByRange(font_name, size, color, CHAR_MIN, CHAR_MAX);
+}
 
-		glyph -> Texture = SDL_CreateTextureFromSurface(Renderer, surface);
 
-		if (glyph -> Texture == NULL)
-			SDLA_ExitWithError("Impossible to create the texture.");
+// Adds a glyph quad to the batch of the given cached font:
+static void batchGlyph(CachedFont *cached_font, Glyph *glyph, int x, int y)
+{
+	if (cached_font -> BatchLength == cached_font -> BatchCapacity)
+	{
+		int capacity = Max(64, 2 * cached_font -> BatchCapacity);
 
-		SDL_FreeSurface(surface);
+		SDL_Vertex *vertices = (SDL_Vertex*) realloc(cached_font -> Vertices, 4 * capacity * sizeof(SDL_Vertex));
+		int *indices = (int*) realloc(cached_font -> Indices, 6 * capacity * sizeof(int));
 
-		if (TTF_GlyphMetrics(font, i + ch_min, &(glyph -> xMin), &(glyph -> xMax), NULL, NULL, NULL) == -1)
-			SDLA_ExitWithError("Impossible to find the glyphe size.");
+		if (vertices == NULL || indices == NULL)
+			SDLA_ExitWithError("Impossible to allocate enough memory for the glyphs batch.");
+
+		cached_font -> Vertices = vertices;
+		cached_font -> Indices = indices;
+		cached_font -> BatchCapacity = capacity;
 	}
 
-	TTF_CloseFont(font);
+	int atlas_width = cached_font -> AtlasWidth, atlas_height = cached_font -> AtlasHeight;
 
-	return cache;
-}
+	SDL_Rect *rect = &(glyph -> Rect);
 
+	float x0 = x, y0 = y, x1 = x + rect -> w, y1 = y + rect -> h;
+	float u0 = (float) rect -> x / atlas_width, v0 = (float) rect -> y / atlas_height;
+	float u1 = (float) (rect -> x + rect -> w) / atlas_width, v1 = (float) (rect -> y + rect -> h) / atlas_height;
 
-// Cache all supported characters of the given font as separated textures.
-CachedFont* SDLA_CachingFontAll(char *font_name, short size, SDL_Color *color)
-{
-	return SDLA_CachingFontByRange(font_name, size, color, CHAR_MIN, CHAR_MAX);
+	SDL_Color white = {255, 255, 255, 255}; // The atlas is already colored.
+
+	int first = 4 * cached_font -> BatchLength;
+
+	SDL_Vertex *vertex = cached_font -> Vertices + first;
+
+	vertex[0] = (SDL_Vertex) {{x0, y0}, white, {u0, v0}};
+	vertex[1] = (SDL_Vertex) {{x1, y0}, white, {u1, v0}};
+	vertex[2] = (SDL_Vertex) {{x1, y1}, white, {u1, v1}};
+	vertex[3] = (SDL_Vertex) {{x0, y1}, white, {u0, v1}};
+
+	int *index = cached_font -> Indices + 6 * cached_font -> BatchLength;
+
+	index[0] = first;
+	index[1] = first + 1;
+	index[2] = first + 2;
+	index[3] = first;
+	index[4] = first + 2;
+	index[5] = first + 3;
+
+	++(cached_font -> BatchLength);
 }
 
 
-// Draws the given text at the given coordinates, with the cached font method.
+// Draws the given text at the given coordinates, with the cached font method. The whole text is drawn
+// with a single call to SDL_RenderGeometry(), when supported by the SDL version.
 // Unsupported: automatic carriage return. DO NOT use this with SDLA_CENTERED.
 void SDLA_DrawCachedFont(CachedFont *cached_font, int x, int y, char *text)
 {
@@ -467,6 +695,8 @@ void SDLA_DrawCachedFont(CachedFont *cached_font, int x, int y, char *text)
 	int xStep = size / 25, xSpace = size / 3, yStep = height;
 	int xPos = x, yPos = y, i = 0;
 
+	cached_font -> BatchLength = 0;
+
 	while (text[i] != '\0')
 	{
 		char current_ch = text[i];
@@ -492,20 +722,42 @@ void SDLA_DrawCachedFont(CachedFont *cached_font, int x, int y, char *text)
 
 		else
 		{
-			Glyph *current_glyph = cached_font -> Table + current_ch - cached_font -> Ch_min;
+			Glyph *current_glyph = getGlyph(cached_font, current_ch);
 
-			SDLA_DrawTexture(current_glyph -> Texture, xPos, yPos);
+			batchGlyph(cached_font, current_glyph, xPos, yPos);
 
-			if (next_ch >= cached_font -> Ch_min && next_ch <= cached_font -> Ch_max)
-			{
-				Glyph *next_glyph = cached_font -> Table + next_ch - cached_font -> Ch_min;
+			Glyph *next_glyph = getGlyphMetrics(cached_font, next_ch);
 
+			if (next_glyph != NULL)
 				xPos += current_glyph -> xMax - next_glyph -> xMin + xStep;
-			}
 		}
 
 		++i;
 	}
+
+	if (cached_font -> BatchLength == 0)
+		return;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	if (SDL_RenderGeometry(Renderer, cached_font -> Atlas, cached_font -> Vertices, 4 * cached_font -> BatchLength,
+		cached_font -> Indices, 6 * cached_font -> BatchLength) != 0)
+		SDLA_ExitWithError("Impossible to draw the text.");
+#else
+	// One copy per glyph, all from the same texture:
+	for (int k = 0; k < cached_font -> BatchLength; ++k)
+	{
+		SDL_Vertex *vertex = cached_font -> Vertices + 4 * k;
+
+		SDL_Rect dst = {vertex[0].position.x, vertex[0].position.y,
+			vertex[2].position.x - vertex[0].position.x, vertex[2].position.y - vertex[0].position.y};
+
+		SDL_Rect src = {nearbyintf(vertex[0].tex_coord.x * cached_font -> AtlasWidth),
+			nearbyintf(vertex[0].tex_coord.y * cached_font -> AtlasHeight), dst.w, dst.h};
+
+		if (SDL_RenderCopy(Renderer, cached_font -> Atlas, &src, &dst) != 0)
+			SDLA_ExitWithError("Impossible to draw the texture.");
+	}
+#endif
 }
 
 
@@ -536,7 +788,10 @@ int SDLA_CachedTextSize(CachedFont *cached_font, char *text)
 
 		else
 		{
-			Glyph *glyph = cached_font -> Table + text[i] - cached_font -> Ch_min;
+			Glyph *glyph = getGlyphMetrics(cached_font, text[i]);
+
+			if (glyph == NULL)
+				SDLA_ExitWithError("Unsupported character.");
 
 			xSize += glyph -> xMax - glyph -> xMin;
 		}
@@ -554,20 +809,17 @@ void SDLA_FreeCachedFont(CachedFont *cached_font)
 	if (cached_font == NULL)
 		SDLA_ExitWithError("Font not cached.");
 
-	int number = cached_font -> Ch_max - cached_font -> Ch_min + 1;
-
-	for (int i = 0; i < number; ++i)
-	{
-		Glyph *glyph = cached_font -> Table + i;
-		SDL_DestroyTexture(glyph -> Texture);
-	}
+	SDL_DestroyTexture(cached_font -> Atlas);
+	TTF_CloseFont(cached_font -> Font);
 
+	free(cached_font -> Vertices);
+	free(cached_font -> Indices);
 	free(cached_font -> Table);
 	free(cached_font);
 }
 
 
-// Prints the given cached font details in the console.
+// Prints the given cached font details in the console. Glyphs are only listed once used.
 void SDLA_PrintCachedFontInfo(CachedFont *cached_font)
 {
 	if (cached_font == NULL)
@@ -583,7 +835,11 @@ void SDLA_PrintCachedFontInfo(CachedFont *cached_font)
 	{
 		Glyph *glyph = cached_font -> Table + i;
 
+		if (!(glyph -> Loaded & SDLA_GLYPH_METRICS))
+			continue;
+
 		char current_ch = i + cached_font -> Ch_min;
-		printf("char: %c, ascii: %d, xMin: %d, xMax: %d\n", current_ch, current_ch, glyph -> xMin, glyph -> xMax);
+		printf("char: %c, ascii: %d, xMin: %d, xMax: %d, rendered: %d\n", current_ch, current_ch, glyph -> xMin,
+			glyph -> xMax, (glyph -> Loaded & SDLA_GLYPH_RENDERED) != 0);
 	}
 }
@@ -12,7 +12,7 @@
 #ifndef SDLA_H
 #define SDLA_H
 
-#define SDLA_VERSION 1.5
+#define SDLA_VERSION 1.6
 
 #if __cplusplus
 extern "C" {
@@ -30,12 +30,31 @@ extern "C" {
 typedef enum {SDLA_SOLID, SDLA_BLENDED} SDLA_FontAliasing;
 
 
+// SDL_RenderGeometry() and SDL_Vertex are only available from SDL v2.0.18. For older versions,
+// the same vertex layout is used, cached fonts are then drawn with one copy per glyph:
+#if !SDL_VERSION_ATLEAST(2, 0, 18)
+typedef struct
+{
+	struct {float x, y;} position;
+	SDL_Color color;
+	struct {float x, y;} tex_coord;
+} SDL_Vertex;
+#endif
+
+
 // Structs for caching fonts:
+#define SDLA_GLYPH_METRICS 1
+#define SDLA_GLYPH_RENDERED 2
+
+#define SDLA_ATLAS_COLUMNS 16 // Glyphs per row in the atlas of a cached font.
+
+
 typedef struct
 {
-	SDL_Texture *Texture;
+	SDL_Rect Rect; // Location in the atlas.
 	int xMin;
 	int xMax;
+	int Loaded; // Combination of SDLA_GLYPH_METRICS and SDLA_GLYPH_RENDERED.
 } Glyph;
 
 
@@ -46,6 +65,19 @@ typedef struct
 	char Ch_min;
 	char Ch_max;
 	Glyph *Table;
+
+	TTF_Font *Font;
+	SDL_Color Color;
+	SDL_Texture *Atlas; // Every glyph, each in a cell of CellWidth x Height pixels.
+	int AtlasWidth;
+	int AtlasHeight;
+	int CellWidth;
+
+	// Buffers for drawing a whole text at once:
+	SDL_Vertex *Vertices;
+	int *Indices;
+	int BatchLength; // In glyphs.
+	int BatchCapacity;
 } CachedFont;
 
 
@@ -72,6 +104,14 @@ void SDLA_Init(SDL_Window **window, SDL_Renderer **renderer, char *window_name,
 	int hardware_acceleration, SDLA_FontAliasing aliasing);
 
 
+// Enables or disables vsync. Returns 0 on success, -1 if not supported (SDL < 2.0.18, or by the renderer).
+int SDLA_SetVSync(int enabled);
+
+
+// Returns the refresh rate of the display the window is on, or 0 if unknown.
+int SDLA_GetRefreshRate(void);
+
+
 // Initialize the text input subsystem of SDLA. Returns the string to be filled with text input.
 // That string has to be freed by the user upon exiting.
 char* SDLA_InitTextInput(int text_input_length);
@@ -101,6 +141,20 @@ SDL_Texture* SDLA_CreateTextureBMP(char *image_name, SDL_Color *transparency_col
 SDL_Texture* SDLA_CreateTextTexture(TTF_Font *font, SDL_Color *color, char *text);
 
 
+// Creates a fully transparent texture of format SDL_PIXELFORMAT_ARGB8888, with blending enabled.
+// Parts of it can then be filled with SDLA_UpdateTextTexture(). Useful for building atlases.
+SDL_Texture* SDLA_CreateBlankTexture(int width, int height);
+
+
+// Creates a texture which can be used as a render target, with SDL_SetRenderTarget().
+SDL_Texture* SDLA_CreateTargetTexture(int width, int height);
+
+
+// Renders the text in the given area of a texture created by SDLA_CreateBlankTexture(). The rest of
+// the area is made transparent, and the text is clipped if too big. Returns the width of the drawn text.
+int SDLA_UpdateTextTexture(SDL_Texture *texture, SDL_Rect *area, TTF_Font *font, SDL_Color *color, char *text);
+
+
 ////////////////////////////////////////////////////////////////////////////////////
 // Drawing:
 ////////////////////////////////////////////////////////////////////////////////////
@@ -161,16 +215,17 @@ void SDLA_SetTextInputContent(char *text_input, char *new_content);
 // This needs a SDLA_Init() call in order to work.
 
 
-// Cache characters (from ch_min to ch_max) of the given font as separated textures,
-// in order to draw them dynamically and efficiently.
+// Cache characters (from ch_min to ch_max) of the given font in a single atlas texture, in order to
+// draw them dynamically and efficiently. Glyphs are only rendered in the atlas when first drawn.
 CachedFont* SDLA_CachingFontByRange(char *font_name, short size, SDL_Color *color, char ch_min, char ch_max);
 
 
-// Cache all supported characters of the given font as separated textures.
+// Cache all supported characters of the given font in a single atlas texture.
 CachedFont* SDLA_CachingFontAll(char *font_name, short size, SDL_Color *color);
 
 
-// Draws the given text at the given coordinates, with the cached font method.
+// Draws the given text at the given coordinates, with the cached font method. The whole text is drawn
+// with a single call to SDL_RenderGeometry(), when supported by the SDL version.
 // Unsupported: automatic carriage return. DO NOT use this with SDLA_CENTERED.
 void SDLA_DrawCachedFont(CachedFont *cached_font, int x, int y, char *text);
 
@@ -184,7 +239,7 @@ int SDLA_CachedTextSize(CachedFont *cached_font, char *text);
 void SDLA_FreeCachedFont(CachedFont *cached_font);
 
 
-// Prints the given cached font details in the console.
+// Prints the given cached font details in the console. Glyphs are only listed once used.
 void SDLA_PrintCachedFontInfo(CachedFont *cached_font);
 
 
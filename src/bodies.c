@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 #include "bodies.h"
 #include "physics.h"
+#include "labels.h"
+#include "frames.h"
 
 
 // Number of supported BodyType:
@@ -14,6 +17,36 @@ static const short BodyTypeNumber = APPLY_BODY(SUM_MACRO);
 static const char* BodyTypeStringArray[] = {APPLY_BODY(TO_STRING)};
 
 
+// Compilation fails if a state doesn't fit in exactly one cache line:
+typedef char BodyStateSizeCheck[sizeof(BodyState) == BODY_STATE_ALIGNMENT ? 1 : -1];
+
+
+const BodyHandle NoBody = {-1, 0};
+
+// Bodies arena. Slots are allocated by blocks of BODY_ARENA_BLOCK_SIZE bodies, which are never moved.
+// Hot and cold parts are stored in separate blocks, with the same slot indexes:
+static Body **Blocks = NULL;
+static BodyState **StateBlocks = NULL; // Aligned.
+static void **StateBlocksMemory = NULL; // As allocated, for freeing them.
+static int BlocksNumber = 0;
+static int SlotsNumber = 0;
+
+// Bodies may be moved to other slots, hence handles refer to ids. The generation of an id is
+// increased each time its body is freed. Free slots and free ids are chained in free lists:
+static unsigned int *Generations = NULL;
+static int *IdSlots = NULL;
+static int *NextFreeId = NULL;
+static int *NextFreeSlot = NULL;
+static int FreeIdHead = -1;
+static int FreeSlotHead = -1;
+
+// Buffers used when moving bodies:
+static Body *MovedBodies = NULL;
+static BodyState *MovedStates = NULL;
+static int *MovedSlots = NULL;
+static int MovedCapacity = 0;
+
+
 // Returns the number of supported BodyType:
 short getBodyTypeNumber(void)
 {
@@ -52,42 +85,299 @@ BodyType getBodyID(char *string)
 }
 
 
-// Free with a regular free() call.
+static Body* slotBody(int slot)
+{
+	return Blocks[slot / BODY_ARENA_BLOCK_SIZE] + slot % BODY_ARENA_BLOCK_SIZE;
+}
+
+
+static BodyState* slotState(int slot)
+{
+	return StateBlocks[slot / BODY_ARENA_BLOCK_SIZE] + slot % BODY_ARENA_BLOCK_SIZE;
+}
+
+
+// Adds a block of free slots to the arena:
+static void growArena(void)
+{
+	int new_slots_number = SlotsNumber + BODY_ARENA_BLOCK_SIZE;
+
+	Body **blocks = (Body**) realloc(Blocks, (BlocksNumber + 1) * sizeof(Body*));
+	BodyState **state_blocks = (BodyState**) realloc(StateBlocks, (BlocksNumber + 1) * sizeof(BodyState*));
+	void **state_blocks_memory = (void**) realloc(StateBlocksMemory, (BlocksNumber + 1) * sizeof(void*));
+	unsigned int *generations = (unsigned int*) realloc(Generations, new_slots_number * sizeof(unsigned int));
+	int *id_slots = (int*) realloc(IdSlots, new_slots_number * sizeof(int));
+	int *next_free_id = (int*) realloc(NextFreeId, new_slots_number * sizeof(int));
+	int *next_free_slot = (int*) realloc(NextFreeSlot, new_slots_number * sizeof(int));
+
+	if (blocks == NULL || state_blocks == NULL || state_blocks_memory == NULL || generations == NULL ||
+		id_slots == NULL || next_free_id == NULL || next_free_slot == NULL)
+	{
+		printf("\nNot enough memory to grow the bodies arena.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Blocks = blocks;
+	StateBlocks = state_blocks;
+	StateBlocksMemory = state_blocks_memory;
+	Generations = generations;
+	IdSlots = id_slots;
+	NextFreeId = next_free_id;
+	NextFreeSlot = next_free_slot;
+
+	Blocks[BlocksNumber] = (Body*) calloc(BODY_ARENA_BLOCK_SIZE, sizeof(Body));
+
+	// Over-allocating, for the states to be aligned:
+	void *memory = calloc(1, BODY_ARENA_BLOCK_SIZE * sizeof(BodyState) + BODY_STATE_ALIGNMENT - 1);
+
+	if (Blocks[BlocksNumber] == NULL || memory == NULL)
+	{
+		printf("\nNot enough memory to grow the bodies arena.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	StateBlocksMemory[BlocksNumber] = memory;
+	StateBlocks[BlocksNumber] = (BodyState*) (((uintptr_t) memory + BODY_STATE_ALIGNMENT - 1)
+		& ~(uintptr_t) (BODY_STATE_ALIGNMENT - 1));
+
+	// As many new ids as new slots:
+
+	for (int i = SlotsNumber; i < new_slots_number; ++i)
+	{
+		Generations[i] = 0;
+		IdSlots[i] = -1;
+		NextFreeId[i] = i + 1 < new_slots_number ? i + 1 : FreeIdHead;
+		NextFreeSlot[i] = i + 1 < new_slots_number ? i + 1 : FreeSlotHead;
+	}
+
+	FreeIdHead = SlotsNumber;
+	FreeSlotHead = SlotsNumber;
+	SlotsNumber = new_slots_number;
+	++BlocksNumber;
+}
+
+
+// Bodies are allocated in an arena of contiguous slots. Free with freeBody().
 Body* createBody(char *name, BodyType type, double radius, double mass,
 	double initPosX, double initPosY, double initSpeedX, double initSpeedY)
 {
-	Body *body = (Body*) calloc(1, sizeof(Body));
+	if (FreeSlotHead == -1)
+		growArena();
+
+	int slot = FreeSlotHead;
+	FreeSlotHead = NextFreeSlot[slot];
+
+	int id = FreeIdHead;
+	FreeIdHead = NextFreeId[id];
+
+	IdSlots[id] = slot;
+
+	Body *body = slotBody(slot);
+	BodyState *state = slotState(slot);
+
+	memset(body, 0, sizeof(Body));
+	memset(state, 0, sizeof(BodyState));
+
+	body -> State = state;
+	body -> ArenaSlot = slot;
+	body -> Id = id;
 
 	// Copying the name, including the final '\0'. Name will be truncated if too big:
 	snprintf(body -> Name, MAX_NAME_LENGTH + 1, "%s", name);
 
 	*(BodyType*) &(body -> Type) = type;
-	*(double*) &(body -> Radius) = radius;
 	*(double*) &(body -> Mass) = mass;
-	*(double*) &(body -> GravityFactor) = GravitationalConst * mass; // For optimization.
+	*(double*) &(state -> Radius) = radius;
+	*(double*) &(state -> GravityFactor) = GravitationalConst * mass; // For optimization.
+
+	state -> PosX = initPosX;
+	state -> PosY = initPosY;
+	state -> SpeedX = initSpeedX;
+	state -> SpeedY = initSpeedY;
+	state -> AccelX = 0.; // by default.
+	state -> AccelY = 0.; // by default.
 
-	body -> PosX = initPosX;
-	body -> PosY = initPosY;
-	body -> SpeedX = initSpeedX;
-	body -> SpeedY = initSpeedY;
-	body -> AccelX = 0.; // by default.
-	body -> AccelY = 0.; // by default.
+	body -> PrevPosX = initPosX;
+	body -> PrevPosY = initPosY;
 
-	// Must be done no matter the value of 'DrawAllNames':
-	body -> TextureName = SDLA_CreateTextTexture(font_small, &White, body -> Name); // truncated name if needed.
+	// The name label is only rendered once the body is drawn, see labels.c:
+	body -> LabelSlot = -1;
+
+	body -> Parent = NoBody; // Absolute coordinates.
 
 	return body;
 }
 
 
-// Necessary to use this over a regular free() call, in case textures have been created.
+// Gives back the body slot to the arena, and frees its label if one has been created.
 void freeBody(Body *body)
 {
 	if (body == NULL)
 		return;
 
-	SDL_DestroyTexture(body -> TextureName);
-	free(body);
+	releaseLabel(body);
+
+	int slot = body -> ArenaSlot, id = body -> Id;
+
+	++Generations[id]; // Invalidates the handles to this body.
+	IdSlots[id] = -1;
+
+	NextFreeId[id] = FreeIdHead;
+	FreeIdHead = id;
+
+	NextFreeSlot[slot] = FreeSlotHead;
+	FreeSlotHead = slot;
+}
+
+
+// To be done upon exit, once every body has been freed.
+void freeBodyArena(void)
+{
+	for (int i = 0; i < BlocksNumber; ++i)
+	{
+		free(Blocks[i]);
+		free(StateBlocksMemory[i]);
+	}
+
+	free(Blocks);
+	free(StateBlocks);
+	free(StateBlocksMemory);
+	free(Generations);
+	free(IdSlots);
+	free(NextFreeId);
+	free(NextFreeSlot);
+
+	free(MovedBodies);
+	free(MovedStates);
+	free(MovedSlots);
+
+	Blocks = NULL;
+	StateBlocks = NULL;
+	StateBlocksMemory = NULL;
+	Generations = NULL;
+	IdSlots = NULL;
+	NextFreeId = NULL;
+	NextFreeSlot = NULL;
+
+	MovedBodies = NULL;
+	MovedStates = NULL;
+	MovedSlots = NULL;
+	MovedCapacity = 0;
+
+	BlocksNumber = 0;
+	SlotsNumber = 0;
+	FreeIdHead = -1;
+	FreeSlotHead = -1;
+}
+
+
+// Returns a handle to the given body, NoBody for NULL.
+BodyHandle getBodyHandle(Body *body)
+{
+	if (body == NULL)
+		return NoBody;
+
+	BodyHandle handle = {body -> Id, Generations[body -> Id]};
+
+	return handle;
+}
+
+
+// Returns the body referenced by the handle, or NULL if it has been freed.
+Body* getBody(BodyHandle handle)
+{
+	if (handle.Id < 0 || handle.Id >= SlotsNumber || Generations[handle.Id] != handle.Generation)
+		return NULL;
+
+	return slotBody(IdSlots[handle.Id]);
+}
+
+
+static int compareSlots(const void *slot1, const void *slot2)
+{
+	return *(const int*) slot1 - *(const int*) slot2;
+}
+
+
+// Moves the given bodies in the arena, so that their order in memory follows their order in the array,
+// which is updated. Handles stay valid, but any other pointer to those bodies or their states doesn't.
+void arrangeBodies(Body **bodies, int bodies_number)
+{
+	if (bodies_number > MovedCapacity)
+	{
+		free(MovedBodies);
+		free(MovedStates);
+		free(MovedSlots);
+
+		MovedBodies = (Body*) calloc(bodies_number, sizeof(Body));
+		MovedStates = (BodyState*) calloc(bodies_number, sizeof(BodyState));
+		MovedSlots = (int*) calloc(bodies_number, sizeof(int));
+
+		if (MovedBodies == NULL || MovedStates == NULL || MovedSlots == NULL)
+		{
+			printf("\nNot enough memory to move the bodies.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		MovedCapacity = bodies_number;
+	}
+
+	// The set of used slots stays the same, bodies are just placed in increasing slots order:
+
+	int number = 0;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		if (bodies[i] == NULL)
+			continue;
+
+		memcpy(MovedBodies + number, bodies[i], sizeof(Body));
+		memcpy(MovedStates + number, bodies[i] -> State, sizeof(BodyState));
+		MovedSlots[number] = bodies[i] -> ArenaSlot;
+
+		++number;
+	}
+
+	qsort(MovedSlots, number, sizeof(int), compareSlots);
+
+	int moved = 0;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		if (bodies[i] == NULL)
+			continue;
+
+		int slot = MovedSlots[moved];
+
+		Body *body = slotBody(slot);
+
+		memcpy(body, MovedBodies + moved, sizeof(Body));
+		memcpy(slotState(slot), MovedStates + moved, sizeof(BodyState));
+
+		body -> State = slotState(slot);
+		body -> ArenaSlot = slot;
+		IdSlots[body -> Id] = slot;
+
+		bodies[i] = body;
+
+		++moved;
+	}
+}
+
+
+// Returns the index of the given body in the bodies array, -1 if not found.
+int findBodyIndex(Body **bodies, int bodies_number, Body *body)
+{
+	if (body == NULL)
+		return -1;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		if (bodies[i] == body)
+			return i;
+	}
+
+	return -1;
 }
 
 
@@ -97,8 +387,16 @@ void printBodyInfo(Body *body)
 		return;
 
 	printf("Name: %s, Type: %s\n", body -> Name, getBodyTypeName(body -> Type));
-	printf("Radius: %.2e m, Mass: %.2e kg\n", body -> Radius, body -> Mass);
-	printf("PosX: %.2e m, PosY: %.2e m\n", body -> PosX, body -> PosY);
-	printf("SpeedX: %.2e m/s, SpeedY: %.2e m/s\n", body -> SpeedX, body -> SpeedY);
-	printf("AccelX: %.2e m/s2, AccelY: %.2e m/s2\n\n", body -> AccelX, body -> AccelY);
+	BodyState *state = body -> State;
+
+	double pos_x, pos_y, speed_x, speed_y, accel_x, accel_y;
+
+	getAbsolutePosition(body, &pos_x, &pos_y);
+	getAbsoluteSpeed(body, &speed_x, &speed_y);
+	getAbsoluteAcceleration(body, &accel_x, &accel_y);
+
+	printf("Radius: %.2e m, Mass: %.2e kg\n", state -> Radius, body -> Mass);
+	printf("PosX: %.2e m, PosY: %.2e m\n", pos_x, pos_y);
+	printf("SpeedX: %.2e m/s, SpeedY: %.2e m/s\n", speed_x, speed_y);
+	printf("AccelX: %.2e m/s2, AccelY: %.2e m/s2\n\n", accel_x, accel_y);
 }
@@ -6,8 +6,6 @@
 #include "settings.h"
 
 
-extern TTF_Font *font_small;
-extern SDL_Color White;
 extern const double GravitationalConst;
 
 
@@ -32,15 +30,13 @@ extern const double GravitationalConst;
 typedef enum {APPLY_BODY(ID_MACRO)} BodyType;
 
 
-typedef struct
-{
-	char Name[MAX_NAME_LENGTH + 1];
+#define BODY_STATE_ALIGNMENT 64
 
-	const BodyType Type;
-	const double Radius;
-	const double Mass;
-	const double GravityFactor; // For optimization.
 
+// Hot part of a body: everything used by the physics substeps, in exactly one cache line.
+// States are allocated BODY_STATE_ALIGNMENT bytes aligned.
+typedef struct
+{
 	double PosX;
 	double PosY;
 	double SpeedX;
@@ -48,10 +44,49 @@ typedef struct
 	double AccelX;
 	double AccelY;
 
-	SDL_Texture *TextureName;
+	const double GravityFactor; // For optimization.
+	const double Radius;
+} BodyState;
+
+
+// Reference to a body which stays valid whatever the position of the body in the bodies array or in memory.
+// Once the body is freed, the handle resolves to NULL, even if its id has been reused.
+typedef struct
+{
+	int Id;
+	unsigned int Generation;
+} BodyHandle;
+
+
+// Cold part of a body, which references its hot part:
+typedef struct
+{
+	BodyState *State; // Only moves along with the body, see arrangeBodies().
+
+	char Name[MAX_NAME_LENGTH + 1];
+
+	const BodyType Type;
+	const double Mass;
+
+	double PrevPosX; // Position before the last physics step, for drawing interpolation.
+	double PrevPosY;
+
+	int LabelSlot; // Slot of the name in the labels atlas, -1 if none. Managed by labels.c.
+
+	// With REFERENCE_FRAMES, body the position, speed and previous position are relative to, NoBody if they are
+	// absolute. Managed by frames.c:
+	BodyHandle Parent;
+
+	int StateIndex; // Index of the state in the physics arrays, for massive bodies. Managed by physics.c.
+
+	int ArenaSlot; // Managed by bodies.c.
+	int Id;
 } Body;
 
 
+extern const BodyHandle NoBody;
+
+
 // Returns the number of supported BodyType:
 short getBodyTypeNumber(void);
 
@@ -64,15 +99,36 @@ const char* getBodyTypeName(BodyType type);
 BodyType getBodyID(char *string);
 
 
-// Free with a regular free() call.
+// Bodies are allocated in an arena of contiguous slots. Free with freeBody().
 Body* createBody(char *name, BodyType type, double radius, double mass,
 	double initPosX, double initPosY, double initSpeedX, double initSpeedY);
 
 
-// Necessary to use this over a regular free() call, in case textures have been created.
+// Gives back the body slot to the arena, and frees its label if one has been created.
 void freeBody(Body *body);
 
 
+// To be done upon exit, once every body has been freed.
+void freeBodyArena(void);
+
+
+// Returns a handle to the given body, NoBody for NULL.
+BodyHandle getBodyHandle(Body *body);
+
+
+// Returns the body referenced by the handle, or NULL if it has been freed.
+Body* getBody(BodyHandle handle);
+
+
+// Moves the given bodies in the arena, so that their order in memory follows their order in the array,
+// which is updated. Handles stay valid, but any other pointer to those bodies or their states doesn't.
+void arrangeBodies(Body **bodies, int bodies_number);
+
+
+// Returns the index of the given body in the bodies array, -1 if not found.
+int findBodyIndex(Body **bodies, int bodies_number, Body *body);
+
+
 void printBodyInfo(Body *body);
 
 
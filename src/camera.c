@@ -5,6 +5,8 @@
 
 #include "settings.h"
 #include "camera.h"
+#include "physics.h"
+#include "frames.h"
 
 
 // Drawing frame size:
@@ -38,6 +40,9 @@ static const double B_2 = M3 + H1 + SLOPE * M1;
 // Scale of the simulation:
 static double Scale = MIN(WINDOW_WIDTH - LEFT_MARGIN, WINDOW_HEIGHT) / (2. * MAX_RADIUS);
 
+// Fraction of a physics step elapsed since the last one, when drawing:
+static double DrawingAlpha = 0.;
+
 
 // Public function for getting the 'Scale' value:
 inline double getScale(void)
@@ -76,13 +81,11 @@ inline int getPixel(double value)
 	double used_value = RAW_PIXELS_DRAWING ? value : nearbyint(value);
 
 	// Casting a floating point number to an integer, while said number is too big to be
-	// representable as an integer is undefined behavior. To be sure everything works properly:
-
-	if (used_value >= INT_MAX)
-		return INT_MAX;
+	// representable as an integer is undefined behavior. To be sure everything works properly.
+	// Branchless, in order for screenTransform() to be vectorized:
 
-	if (used_value <= INT_MIN)
-		return INT_MIN;
+	used_value = used_value >= INT_MAX ? INT_MAX : used_value;
+	used_value = used_value <= INT_MIN ? INT_MIN : used_value;
 
 	return (int) used_value;
 }
@@ -120,8 +123,92 @@ void followBody(Body *body)
 		return;
 	}
 
-	Xorigin = body -> PosX;
-	Yorigin = body -> PosY;
+	getDrawnPosition(body, &Xorigin, &Yorigin);
+}
+
+
+// Sets the fraction of a physics step elapsed since the last one, in [0, 1[, used by getDrawnPosition().
+void setDrawingInterpolation(double alpha)
+{
+	DrawingAlpha = alpha;
+}
+
+
+// Drawn position of a body, relative to its parent with REFERENCE_FRAMES:
+static void getLocalDrawnPosition(Body *body, double *x, double *y)
+{
+	BodyState *state = body -> State;
+
+	if (DRAWING_INTERPOLATION == 1)
+	{
+		*x = body -> PrevPosX + DrawingAlpha * (state -> PosX - body -> PrevPosX);
+		*y = body -> PrevPosY + DrawingAlpha * (state -> PosY - body -> PrevPosY);
+	}
+
+	else if (DRAWING_INTERPOLATION == 2)
+	{
+		double time = DrawingAlpha * getStepDuration();
+
+		*x = state -> PosX + state -> SpeedX * time;
+		*y = state -> PosY + state -> SpeedY * time;
+	}
+
+	else
+	{
+		*x = state -> PosX;
+		*y = state -> PosY;
+	}
+}
+
+
+// Drawn position of a body relative to the drawn position of 'reference', or absolute if NULL. Local positions
+// are only summed up to the lowest common parent of both, for the result to keep its precision when zooming
+// on bodies far from the origin:
+static void getRelativeDrawnPosition(Body *body, Body *reference, double *x, double *y)
+{
+	double body_x = 0., body_y = 0., reference_x = 0., reference_y = 0., local_x, local_y;
+
+	int body_depth = getFrameDepth(body), reference_depth = getFrameDepth(reference);
+
+	for (; body_depth > reference_depth; --body_depth, body = getParent(body))
+	{
+		getLocalDrawnPosition(body, &local_x, &local_y);
+		body_x += local_x;
+		body_y += local_y;
+	}
+
+	for (; reference_depth > body_depth; --reference_depth, reference = getParent(reference))
+	{
+		getLocalDrawnPosition(reference, &local_x, &local_y);
+		reference_x += local_x;
+		reference_y += local_y;
+	}
+
+	for (; body != reference; body = getParent(body), reference = getParent(reference))
+	{
+		getLocalDrawnPosition(body, &local_x, &local_y);
+		body_x += local_x;
+		body_y += local_y;
+
+		getLocalDrawnPosition(reference, &local_x, &local_y);
+		reference_x += local_x;
+		reference_y += local_y;
+	}
+
+	*x = body_x - reference_x;
+	*y = body_y - reference_y;
+}
+
+
+// Position at which a body is drawn. Depending on DRAWING_INTERPOLATION, it is interpolated between
+// the two last physics states, or extrapolated from the last one, so that motion stays smooth
+// whatever the number of physics steps per displayed frame.
+void getDrawnPosition(Body *body, double *x, double *y)
+{
+	if (FRAMES_ENABLED)
+		getRelativeDrawnPosition(body, NULL, x, y);
+	else
+		getLocalDrawnPosition(body, x, y);
 }
 
 
@@ -147,8 +234,8 @@ void bodyScreenCheck(double x, double y, double radius, int *may_appear, int *is
 	*may_appear = (xmax_1 >= xmin_2 && xmin_1 <= xmax_2) && (ymax_1 >= ymin_2 && ymin_1 <= ymax_2);
 
 	// *is_covered = (xmin_1 >= xmin_2 && xmax_1 <= xmax_2) && (ymin_1 >= ymin_2 && ymax_1 <= ymax_2); // box only.
-	*is_covered = isInCircle(x, y, radius, xmin_2, ymin_2) && isInCircle(x, y, radius, xmin_2, ymax_2) &&
-		isInCircle(x, y, radius, xmax_2, ymin_2) && isInCircle(x, y, radius, xmax_2, ymax_2); // circle only.
+	*is_covered = isInCircle(x, y, radius, xmin_1, ymin_1) && isInCircle(x, y, radius, xmin_1, ymax_1) &&
+		isInCircle(x, y, radius, xmax_1, ymin_1) && isInCircle(x, y, radius, xmax_1, ymax_1); // circle only.
 }
 
 
@@ -187,3 +274,159 @@ void findFrameIntersection(double targetX, double targetY, int *intersX, int *in
 		*intersX = CenterX + (*intersY - CenterY) / ratio;
 	}
 }
+
+
+// Grows the buffers of 'screen' if needed:
+static void reserveScreenBodies(ScreenBodies *screen, int bodies_number)
+{
+	if (bodies_number <= screen -> Capacity)
+		return;
+
+	freeScreenBodies(screen);
+
+	int n = bodies_number;
+
+	screen -> X = (double*) calloc(n, sizeof(double));
+	screen -> Y = (double*) calloc(n, sizeof(double));
+	screen -> R = (double*) calloc(n, sizeof(double));
+	screen -> PixelX = (int*) calloc(n, sizeof(int));
+	screen -> PixelY = (int*) calloc(n, sizeof(int));
+	screen -> PixelR = (int*) calloc(n, sizeof(int));
+	screen -> IsShip = (int*) calloc(n, sizeof(int));
+	screen -> Flags = (unsigned char*) calloc(n, sizeof(unsigned char));
+	screen -> Visible = (int*) calloc(n, sizeof(int));
+	screen -> Covering = (int*) calloc(n, sizeof(int));
+	screen -> OffScreen = (int*) calloc(n, sizeof(int));
+
+	if (screen -> X == NULL || screen -> Y == NULL || screen -> R == NULL || screen -> PixelX == NULL ||
+		screen -> PixelY == NULL || screen -> PixelR == NULL || screen -> IsShip == NULL || screen -> Flags == NULL ||
+		screen -> Visible == NULL || screen -> Covering == NULL || screen -> OffScreen == NULL)
+	{
+		printf("\nNot enough memory to store the on-screen bodies.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	screen -> Capacity = n;
+}
+
+
+// Transforms every body position to screen space in one vectorized pass, and sorts the bodies
+// in the visible, covering and off-screen lists. 'screen' buffers are grown when needed.
+void screenTransform(Body **bodies, int bodies_number, ScreenBodies *screen)
+{
+	reserveScreenBodies(screen, bodies_number);
+
+	double *X = screen -> X, *Y = screen -> Y, *R = screen -> R;
+	int *PixelX = screen -> PixelX, *PixelY = screen -> PixelY, *PixelR = screen -> PixelR;
+	int *IsShip = screen -> IsShip;
+	unsigned char *Flags = screen -> Flags;
+
+	// With REFERENCE_FRAMES, positions are taken relative to the followed body, which is the camera origin,
+	// for them to keep their precision however far from the origin the camera zooms:
+
+	Body *reference = FRAMES_ENABLED && CameraFollowing ? getBody(FollowedBody) : NULL;
+
+	const double x_origin = reference != NULL ? 0. : Xorigin, y_origin = reference != NULL ? 0. : Yorigin;
+
+	// Gathering the bodies data into contiguous arrays. Removed bodies are placed
+	// at the camera origin with a negative radius, so that they get no flag:
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		Body *body = bodies[i];
+
+		if (body == NULL)
+		{
+			X[i] = x_origin;
+			Y[i] = y_origin;
+		}
+
+		else if (reference != NULL)
+			getRelativeDrawnPosition(body, reference, X + i, Y + i);
+
+		else
+			getDrawnPosition(body, X + i, Y + i);
+
+		R[i] = body == NULL ? -1. : body -> State -> Radius;
+		IsShip[i] = body != NULL && body -> Type == Spaceship;
+	}
+
+	// Vectorized pass. Same computations as Xrescale(), Yrescale(), getLength(),
+	// getPixel() and bodyScreenCheck(), with local copies of the camera state:
+
+	const double scale = Scale;
+	const double xmin = LEFT_MARGIN, xmax = WINDOW_WIDTH, ymin = 0, ymax = WINDOW_HEIGHT; // window bounds.
+
+	#pragma omp simd
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		int alive = R[i] >= 0.;
+
+		double x = CenterX + scale * (X[i] - x_origin);
+		double y = CenterY + scale * (Y[i] - y_origin);
+		double r = IsShip[i] ? CROSS_SIZE : scale * R[i];
+
+		X[i] = x;
+		Y[i] = y;
+		R[i] = r;
+
+		PixelX[i] = getPixel(x);
+		PixelY[i] = getPixel(y);
+		PixelR[i] = getPixel(r);
+
+		// Bitwise operators instead of logical ones, to avoid any branch:
+
+		int may_appear = (xmax >= x - r) & (xmin <= x + r) & (ymax >= y - r) & (ymin <= y + r);
+
+		double dx1 = (xmin - x) * (xmin - x), dx2 = (xmax - x) * (xmax - x);
+		double dy1 = (ymin - y) * (ymin - y), dy2 = (ymax - y) * (ymax - y);
+		double r2 = r * r;
+
+		int is_covered = (IsShip[i] == 0) & (dx1 + dy1 <= r2) & (dx1 + dy2 <= r2) & (dx2 + dy1 <= r2) & (dx2 + dy2 <= r2);
+
+		int in_window = (x >= xmin) & (x < xmax) & (y >= ymin) & (y < ymax);
+
+		Flags[i] = alive * ((may_appear & !is_covered) * SCREEN_VISIBLE + is_covered * SCREEN_COVERING +
+			!in_window * SCREEN_OFFSCREEN);
+	}
+
+	// Branchless compaction of the lists:
+
+	int visible_number = 0, covering_number = 0, offscreen_number = 0;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		int flags = Flags[i];
+
+		screen -> Visible[visible_number] = i;
+		screen -> Covering[covering_number] = i;
+		screen -> OffScreen[offscreen_number] = i;
+
+		visible_number += (flags & SCREEN_VISIBLE) != 0;
+		covering_number += (flags & SCREEN_COVERING) != 0;
+		offscreen_number += (flags & SCREEN_OFFSCREEN) != 0;
+	}
+
+	screen -> VisibleNumber = visible_number;
+	screen -> CoveringNumber = covering_number;
+	screen -> OffScreenNumber = offscreen_number;
+}
+
+
+// Frees the buffers of the given ScreenBodies, which can then be reused.
+void freeScreenBodies(ScreenBodies *screen)
+{
+	free(screen -> X);
+	free(screen -> Y);
+	free(screen -> R);
+	free(screen -> PixelX);
+	free(screen -> PixelY);
+	free(screen -> PixelR);
+	free(screen -> IsShip);
+	free(screen -> Flags);
+	free(screen -> Visible);
+	free(screen -> Covering);
+	free(screen -> OffScreen);
+
+	*screen = (ScreenBodies) {0};
+}
@@ -7,6 +7,41 @@
 
 extern TTF_Font *font_medium;
 extern int RenderScene;
+extern int CameraFollowing;
+
+
+// Flags set by screenTransform() for each body:
+#define SCREEN_VISIBLE 1 // The body may appear on-screen, without covering the whole drawing frame.
+#define SCREEN_COVERING 2 // The body covers the whole drawing frame.
+#define SCREEN_OFFSCREEN 4 // The body center is not in the window, a compass may be drawn.
+
+
+// On-screen state of a set of bodies, computed in a single pass by screenTransform(),
+// so that drawing doesn't need to recompute anything. Indexes are those of the bodies array.
+typedef struct
+{
+	int Capacity;
+
+	double *X; // Double precision rescaled coordinates, for the compass.
+	double *Y;
+	double *R; // Double precision on-screen radius. CROSS_SIZE for spaceships.
+
+	int *PixelX; // On-screen coordinates used for drawing.
+	int *PixelY;
+	int *PixelR;
+
+	int *IsShip;
+	unsigned char *Flags;
+
+	int *Visible; // Bodies flagged SCREEN_VISIBLE.
+	int VisibleNumber;
+
+	int *Covering; // Bodies flagged SCREEN_COVERING.
+	int CoveringNumber;
+
+	int *OffScreen; // Bodies flagged SCREEN_OFFSCREEN. Those may also be in one of the two lists above.
+	int OffScreenNumber;
+} ScreenBodies;
 
 
 // Public function for getting the 'Scale' value:
@@ -41,6 +76,16 @@ void moveCamera(double scale_multiplier, int Xdirection, int Ydirection);
 void followBody(Body *body);
 
 
+// Sets the fraction of a physics step elapsed since the last one, in [0, 1[, used by getDrawnPosition().
+void setDrawingInterpolation(double alpha);
+
+
+// Position at which a body is drawn. Depending on DRAWING_INTERPOLATION, it is interpolated between
+// the two last physics states, or extrapolated from the last one, so that motion stays smooth
+// whatever the number of physics steps per displayed frame.
+void getDrawnPosition(Body *body, double *x, double *y);
+
+
 int isInWindow(double x, double y);
 
 
@@ -55,4 +100,13 @@ void bodyScreenCheck(double x, double y, double radius, int *may_appear, int *is
 void findFrameIntersection(double targetX, double targetY, int *intersX, int *intersY);
 
 
+// Transforms every body position to screen space in one vectorized pass, and sorts the bodies
+// in the visible, covering and off-screen lists. 'screen' buffers are grown when needed.
+void screenTransform(Body **bodies, int bodies_number, ScreenBodies *screen);
+
+
+// Frees the buffers of the given ScreenBodies, which can then be reused.
+void freeScreenBodies(ScreenBodies *screen);
+
+
 #endif
@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "settings.h"
+#include "determinism.h"
+#include "physics.h"
+#include "hash.h"
+
+
+// Hash of the masses and states of the given bodies, in their array order. NULL bodies are skipped:
+uint64_t hashBodies(Body **bodies, int bodies_number)
+{
+	uint64_t hash = HASH_INIT;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		if (bodies[i] == NULL)
+			continue;
+
+		hashBytes(&hash, &bodies[i] -> Mass, sizeof(double));
+		hashBytes(&hash, bodies[i] -> State, sizeof(BodyState)); // Only doubles, hence no padding.
+	}
+
+	return hash;
+}
+
+
+// In deterministic mode, prints the hash of the bodies every DETERMINISTIC_HASH_PERIOD physics steps,
+// for runs to be compared. To be called after each physics step.
+void checkDeterminism(Body **bodies, int bodies_number)
+{
+	if (!DETERMINISTIC || DETERMINISTIC_HASH_PERIOD <= 0 || SimulationFrameIndex % DETERMINISTIC_HASH_PERIOD != 0)
+		return;
+
+	printf("Step %u, %.2f days: state hash %016" PRIx64 "\n", SimulationFrameIndex,
+		getSimulationTime() / (24. * 3600.), hashBodies(bodies, bodies_number));
+}
@@ -0,0 +1,19 @@
+#ifndef DETERMINISM_H
+#define DETERMINISM_H
+
+
+#include <stdint.h>
+
+#include "bodies.h"
+
+
+// Hash of the masses and states of the given bodies, in their array order. NULL bodies are skipped:
+uint64_t hashBodies(Body **bodies, int bodies_number);
+
+
+// In deterministic mode, prints the hash of the bodies every DETERMINISTIC_HASH_PERIOD physics steps,
+// for runs to be compared. To be called after each physics step.
+void checkDeterminism(Body **bodies, int bodies_number);
+
+
+#endif
@@ -1,10 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
 
 #include "settings.h"
 #include "drawing.h"
 #include "camera.h"
 #include "physics.h"
+#include "labels.h"
+#include "trails.h"
+#include "governor.h"
+#include "turbo.h"
+#include "frames.h"
 
 
 #define point(x, y) \
@@ -16,108 +23,201 @@
 #define setColor(color) \
 	SDLA_SetDrawColor((color) -> r, (color) -> g, (color) -> b)
 
+#define HUD_BUFFER_SIZE 500
+
 
 static const SDL_Rect HUDrect = {0, 0, LEFT_MARGIN, WINDOW_HEIGHT};
 static const SDL_Rect FrameRect = {LEFT_MARGIN, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
 
 static const char* OnOffStrings[] = {"OFF", "ON"};
 
-static char HUD_buffer_1[500];
-static char HUD_buffer_2[500];
-static char HUD_buffer_3[10];
+static char HUD_buffer_1[HUD_BUFFER_SIZE];
+static char HUD_buffer_2[HUD_BUFFER_SIZE];
 
 static int HUDcounter = 0;
 
+// The HUD panel is cached in a texture, and is only redrawn when its content changes:
+static SDL_Texture *HUDtexture = NULL;
+static int HUDdrawnFollowing = -1;
+static int HUDdrawnStatus = -1;
+
+// Status messages drawn at the bottom of the HUD:
+static char *StatusMessages[] = {"", "Paused.", "Fast-forward."};
+
+
+// On-screen state of the bodies, refreshed at each drawBodies() call:
+static ScreenBodies Screen;
+
+
+static void drawDisk(int x0, int y0, int r);
+
+
+void freeDrawingResources(void)
+{
+	freeScreenBodies(&Screen);
+	freeLabels();
+
+	SDL_DestroyTexture(HUDtexture);
+	HUDtexture = NULL;
+}
+
+
+static void drawBodyLabel(Body **bodies, int index)
+{
+	double r_onScreen = Screen.R[index];
+
+	// Shifting the text down for cosmetic effect:
+	int vertical_shift = MAX(r_onScreen + 10, r_onScreen * 1.1);
+
+	drawLabel(bodies[index], Screen.PixelX[index], Screen.PixelY[index] + vertical_shift);
+}
+
 
 // Draws a set of bodies, along with the user inputs for a spaceship. To not draw them, pass NULL as 'input'.
 void drawBodies(Body **bodies, int bodies_number, Input *input)
 {
-	for (int i = 0; i < bodies_number; ++i)
+	screenTransform(bodies, bodies_number, &Screen);
+
+	// Trails are drawn below the bodies:
+	drawTrails(bodies, bodies_number);
+
+	// Bodies covering the whole frame:
+
+	setColor(&Yellow);
+
+	if (Screen.CoveringNumber > 0)
+		SDL_RenderFillRect(renderer, &FrameRect);
+
+	// Other bodies:
+
+	for (int k = 0; k < Screen.VisibleNumber; ++k)
 	{
-		if (bodies[i] == NULL)
-			continue;
+		int i = Screen.Visible[k];
+
+		if (!Screen.IsShip[i])
+			drawDisk(Screen.PixelX[i], Screen.PixelY[i], Screen.PixelR[i]);
+	}
 
-		double x_rescaled = Xrescale(bodies[i] -> PosX);
-		double y_rescaled = Yrescale(bodies[i] -> PosY);
-		double r_onScreen;
+	// Compasses, using double precision:
 
-		// On-screen coordinates used for drawing:
-		int x_onScreen = getPixel(x_rescaled);
-		int y_onScreen = getPixel(y_rescaled);
+	for (int k = 0; k < Screen.OffScreenNumber; ++k)
+	{
+		int i = Screen.OffScreen[k];
 
-		if (bodies[i] -> Type == Spaceship)
+		if (Screen.IsShip[i])
 		{
 			setColor(&Red);
+			drawCompass(Screen.X[i], Screen.Y[i]);
+			setColor(&Yellow);
+		}
 
-			r_onScreen = CROSS_SIZE;
+		else if (DRAW_COMPASS_ALL_OBJECTS)
+			drawCompass(Screen.X[i], Screen.Y[i]);
+	}
 
-			drawCross(x_onScreen, y_onScreen);
+	// Spaceships, drawn last to stay on top:
 
-			drawCompass(x_rescaled, y_rescaled); // using double precision.
+	for (int k = 0; k < Screen.VisibleNumber; ++k)
+	{
+		int i = Screen.Visible[k];
 
-			// Drawing user inputs:
+		if (!Screen.IsShip[i])
+			continue;
 
-			if (input != NULL && (input -> Xinput != X_NO_INPUT || input -> Yinput != Y_NO_INPUT))
-			{
-				setColor(&Lime);
+		int x_onScreen = Screen.PixelX[i], y_onScreen = Screen.PixelY[i];
 
-				float arrowShiftX = CROSS_SIZE * input -> Xinput;
-				float arrowShiftY = CROSS_SIZE * input -> Yinput;
+		setColor(&Red);
 
-				drawArrow(x_onScreen + arrowShiftX, y_onScreen + arrowShiftY, 2 * arrowShiftX, 2 * arrowShiftY, 0.5);
-			}
-		}
+		drawCross(x_onScreen, y_onScreen);
 
-		else
-		{
-			setColor(&Yellow);
+		// Drawing user inputs:
 
-			if (DRAW_COMPASS_ALL_OBJECTS)
-				drawCompass(x_rescaled, y_rescaled); // using double precision.
+		if (input != NULL && (input -> Xinput != X_NO_INPUT || input -> Yinput != Y_NO_INPUT))
+		{
+			setColor(&Lime);
 
-			r_onScreen = getLength(bodies[i] -> Radius);
+			float arrowShiftX = CROSS_SIZE * input -> Xinput;
+			float arrowShiftY = CROSS_SIZE * input -> Yinput;
 
-			fillCircle(x_rescaled, y_rescaled, r_onScreen); // using double precision.
+			drawArrow(x_onScreen + arrowShiftX, y_onScreen + arrowShiftY, 2 * arrowShiftX, 2 * arrowShiftY, 0.5);
 		}
+	}
 
-		if (DrawAllNames)
-		{
-			int texture_width;
+	if (!DrawAllNames)
+		return;
 
-			if (SDL_QueryTexture(bodies[i] -> TextureName, NULL, NULL, &texture_width, NULL))
-				SDLA_ExitWithError("Cannot find the texture size.");
+	// Names, of which overlapping ones are culled. The followed body gets the priority:
 
-			// Shifting the text down for cosmetic effect:
-			int vertical_shift = MAX(r_onScreen + 10, r_onScreen * 1.1);
+	beginLabelsFrame();
 
-			SDLA_DrawTexture(bodies[i] -> TextureName, x_onScreen - texture_width / 2, y_onScreen + vertical_shift);
-		}
-	}
+	int followed = CameraFollowing ? findBodyIndex(bodies, bodies_number, getBody(FollowedBody)) : -1;
+
+	if (followed >= 0 && Screen.Flags[followed] & ~SCREEN_OFFSCREEN)
+		drawBodyLabel(bodies, followed);
+
+	for (int k = 0; k < Screen.VisibleNumber; ++k)
+		drawBodyLabel(bodies, Screen.Visible[k]);
+
+	for (int k = 0; k < Screen.CoveringNumber; ++k)
+		drawBodyLabel(bodies, Screen.Covering[k]);
 }
 
 
-// Draws the Head-Up Display:
-void drawHUD(Body **bodies, int bodies_number)
+// Writes the formatted text in the HUD buffer. Returns 1 if its content has changed, 0 otherwise.
+static int HUDprintf(char *buffer, const char *format, ...)
+{
+	char temp[HUD_BUFFER_SIZE];
+
+	va_list args;
+	va_start(args, format);
+	vsnprintf(temp, HUD_BUFFER_SIZE, format, args);
+	va_end(args);
+
+	if (strcmp(temp, buffer) == 0)
+		return 0;
+
+	strcpy(buffer, temp);
+	return 1;
+}
+
+
+// Draws the HUD panel on the current render target:
+static void renderHUDpanel(int following, int status)
 {
 	setColor(&HUDcolor);
 
 	SDL_RenderFillRect(renderer, &HUDrect);
 
-	setColor(&White);
+	SDLA_DrawCachedFont(cached_font_medium, HUD_MARGIN, HUD_MARGIN, HUD_buffer_1);
+
+	if (following)
+		SDLA_DrawCachedFont(cached_font_medium, HUD_MARGIN, HUD_MARGIN + 480, HUD_buffer_2);
+
+	if (status != 0)
+		SDLA_DrawCachedFont(cached_font_medium, HUD_MARGIN, HUD_MARGIN + 800, StatusMessages[status]);
+}
+
+
+// Draws the Head-Up Display. The panel is rendered in a texture, which is only redrawn when its content changes:
+void drawHUD(Body **bodies, int bodies_number)
+{
+	int changed = 0;
+	int turbo = isTurboOn();
 
 	if (!SimulationRunning) // paused.
 	{
 		HUDcounter = 0; // To be sure up to date information is drawn during a pause.
 
 		FrameBatchTime = 0.; // To reset it, while the pause is on.
-
-		sprintf(HUD_buffer_3, "Paused.");
-		SDLA_DrawCachedFont(cached_font_medium, HUD_MARGIN, HUD_MARGIN + 800, HUD_buffer_3);
 	}
 
-	if (HUDcounter == 0)
+	// When fast-forwarding, few frames are drawn and each one updates the HUD:
+
+	if (HUDcounter == 0 || turbo)
 	{
-		double fps = FrameBatchTime == 0. ? 0. : (double) HUD_UPDATES_FRAME_STEP / FrameBatchTime;
+		int batch_frames = turbo ? 1 : HUD_UPDATES_FRAME_STEP;
+
+		double fps = FrameBatchTime == 0. ? 0. : batch_frames / FrameBatchTime;
 
 		FrameBatchTime = 0.; // Resetting the sum of frame times, for a new frame batch.
 
@@ -131,38 +231,88 @@ void drawHUD(Body **bodies, int bodies_number)
 		int day = (simulationTime - year * secondsNumberPerYear) / secondsNumberPerDay;
 		int hour = (simulationTime - year * secondsNumberPerYear - day * secondsNumberPerDay) / secondsNumberPerHour;
 
-		sprintf(HUD_buffer_1, "FPS:  %.1f\nDrawing names:  %s\nCollisions:  %s\n\nScale:  %.2e\nXorigin:  %9.2e m\n"
-			"Yorigin:  %9.2e m\n\nTime scale:  %.2e\nYear:  %d\nDay:  %d\nHour:  %d\n\nBodies number:  %.d",
-			fps, OnOffStrings[DrawAllNames], OnOffStrings[CollisionsEnabled], getScale(), Xorigin, Yorigin, getTimeScale(),
-			year, day, hour, bodies_number);
+		char quality[100];
+		getGovernorStatus(quality, sizeof(quality));
+
+		changed |= HUDprintf(HUD_buffer_1, "FPS:  %.1f\nDrawing names:  %s\nDrawing trails:  %s\nCollisions:  %s\n\nScale:  %.2e\n"
+			"Xorigin:  %9.2e m\nYorigin:  %9.2e m\n\nTime scale:  %.2e\nYear:  %d\nDay:  %d\nHour:  %d\n\nBodies number:  %.d\n"
+			"Substeps:  %d, error %.0e\nQuality:  %s", fps, OnOffStrings[DrawAllNames], OnOffStrings[DrawTrails], OnOffStrings[CollisionsEnabled],
+			getScale(), Xorigin, Yorigin, turbo ? getTurboRate() : getTimeScale(), year, day, hour, bodies_number,
+			getSubsteps(), getStepError(), quality);
 	}
 
-	SDLA_DrawCachedFont(cached_font_medium, HUD_MARGIN, HUD_MARGIN, HUD_buffer_1);
+	int following = CameraFollowing;
 
 	if (CameraFollowing)
 	{
-		Body *body = bodies[IndexFollowedBody];
+		Body *body = getBody(FollowedBody);
 
 		if (body == NULL)
 		{
 			printf("Cannot draw info of a NULL body.\n");
-			return;
+			following = 0;
 		}
 
-		if (HUDcounter == 0)
+		else if (HUDcounter == 0 || turbo)
 		{
-			double speed = distance(0, body -> SpeedX, 0, body -> SpeedY);
-			double accel = distance(0, body -> AccelX, 0, body -> AccelY);
+			double pos_x, pos_y, speed_x, speed_y, accel_x, accel_y;
 
-			sprintf(HUD_buffer_2, "Camera following:\n%.15s\n\nType:  %s\nRadius:  %.2e m\nMass:  %.2e kg\nPosX:  %9.2e m\n"
-				"PosY:  %9.2e m\nSpeed:  %.2e m/s\nAccel:   %.2e m/s2", body -> Name, getBodyTypeName(body -> Type),
-				body -> Radius, body -> Mass, body -> PosX, body -> PosY, speed, accel);
-		}
+			getAbsolutePosition(body, &pos_x, &pos_y);
+			getAbsoluteSpeed(body, &speed_x, &speed_y);
+			getAbsoluteAcceleration(body, &accel_x, &accel_y);
 
-		SDLA_DrawCachedFont(cached_font_medium, HUD_MARGIN, HUD_MARGIN + 450, HUD_buffer_2);
+			double speed = distance(0, speed_x, 0, speed_y);
+			double accel = distance(0, accel_x, 0, accel_y);
+
+			changed |= HUDprintf(HUD_buffer_2, "Camera following:\n%.15s\n\nType:  %s\nRadius:  %.2e m\nMass:  %.2e kg\n"
+				"PosX:  %9.2e m\nPosY:  %9.2e m\nSpeed:  %.2e m/s\nAccel:   %.2e m/s2", body -> Name,
+				getBodyTypeName(body -> Type), body -> State -> Radius, body -> Mass, pos_x, pos_y, speed, accel);
+		}
 	}
 
 	HUDcounter = SimulationRunning ? (HUDcounter + 1) % HUD_UPDATES_FRAME_STEP : 0; // stays at 0 while paused.
+
+	int status = !SimulationRunning ? 1 : turbo ? 2 : 0;
+
+	changed |= following != HUDdrawnFollowing || status != HUDdrawnStatus;
+
+	HUDdrawnFollowing = following;
+	HUDdrawnStatus = status;
+
+	// Without render targets support, the panel is simply drawn at each frame:
+
+	if (!SDL_RenderTargetSupported(renderer))
+	{
+		renderHUDpanel(following, status);
+		return;
+	}
+
+	if (HUDtexture == NULL)
+	{
+		HUDtexture = SDLA_CreateTargetTexture(LEFT_MARGIN, WINDOW_HEIGHT);
+		changed = 1;
+	}
+
+	if (changed)
+	{
+		if (SDL_SetRenderTarget(renderer, HUDtexture) != 0)
+			SDLA_ExitWithError("Impossible to draw on the HUD texture.");
+
+		renderHUDpanel(following, status);
+
+		if (SDL_SetRenderTarget(renderer, NULL) != 0)
+			SDLA_ExitWithError("Impossible to draw on the window.");
+	}
+
+	if (SDL_RenderCopy(renderer, HUDtexture, NULL, &HUDrect) != 0)
+		SDLA_ExitWithError("Impossible to draw the HUD texture.");
+}
+
+
+// Forces the HUD panel to be redrawn, e.g. after the render targets have been reset:
+void invalidateHUD(void)
+{
+	HUDdrawnStatus = -1;
 }
 
 
@@ -223,10 +373,13 @@ void fillCircle(double x0, double y0, double radius)
 	}
 
 	// Casting to integers:
-	const int x0_ = getPixel(x0);
-	const int y0_ = getPixel(y0);
-	const int r = getPixel(radius);
+	drawDisk(getPixel(x0), getPixel(y0), getPixel(radius));
+}
 
+
+// Draws a disk from on-screen coordinates, with the current color. No window check is done here.
+static void drawDisk(int x0_, int y0_, int r)
+{
 	if (r <= 0)
 	{
 		point(x0_, y0_);
@@ -23,21 +23,30 @@ extern const double CenterX;
 extern const double CenterY;
 extern double Xorigin;
 extern double Yorigin;
-extern int IndexFollowedBody;
+extern BodyHandle FollowedBody;
 extern int DrawAllNames;
+extern int DrawTrails;
 extern int CollisionsEnabled;
 
 extern double FrameBatchTime;
 
 
+// To be done upon exit.
+void freeDrawingResources(void);
+
+
 // Draws a set of bodies, along with the user inputs for a spaceship. To not draw them, pass NULL as 'input'.
 void drawBodies(Body **bodies, int bodies_number, Input *input);
 
 
-// Draws the Head-Up Display:
+// Draws the Head-Up Display. The panel is rendered in a texture, which is only redrawn when its content changes:
 void drawHUD(Body **bodies, int bodies_number);
 
 
+// Forces the HUD panel to be redrawn, e.g. after the render targets have been reset:
+void invalidateHUD(void);
+
+
 // Draws a compass showing where the object is, when it is not on-screen.
 // Double precision rescaled coordinates must be passed for this to work properly.
 void drawCompass(double targetX, double targetY);
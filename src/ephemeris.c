@@ -0,0 +1,540 @@
+#define _POSIX_C_SOURCE 200809L // For mmap().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "settings.h"
+#include "ephemeris.h"
+#include "physics.h"
+#include "simulations.h"
+#include "hash.h"
+
+
+// Interpolated for each body: position, speed and acceleration along both axes.
+#define COMPONENTS 6
+
+// Fitted from the samples: position and speed, accelerations being derived from the speeds.
+#define FITTED_COMPONENTS 4
+
+#define MAGIC "SPEPHEM1"
+
+
+// The file is made of this header, then of the coefficients of each segment. For each degree, those are stored
+// component by component, and body by body inside a component, so that the interpolation is vectorized over bodies:
+typedef struct
+{
+	char Magic[8];
+	uint64_t Key; // Hash of the initial conditions and of the settings the trajectories depend on.
+	int32_t BodiesNumber;
+	int32_t Degree;
+	int32_t SegmentsNumber;
+	int32_t Unused;
+	double StartTime;
+	double SegmentDuration;
+	char Padding[16]; // For the coefficients to be aligned on a cache line.
+} EphemerisHeader;
+
+
+typedef char EphemerisHeaderSizeCheck[sizeof(EphemerisHeader) == 64 ? 1 : -1];
+
+
+static int EphemerisOn = 0;
+static EphemerisHeader Header;
+static const double *Coefficients = NULL;
+static void *Mapping = NULL; // The mapped file, or NULL.
+static size_t MappingSize = 0;
+static double *OwnedCoefficients = NULL; // Used instead of the file when it can't be written.
+static BodyHandle *Handles = NULL; // Bodies covered by the ephemeris, in the coefficients order.
+static double *Values = NULL; // Interpolated values, in the coefficients order.
+static double Chebyshev[EPHEMERIS_DEGREE + 1];
+
+
+// Number of coefficients per segment:
+static size_t segmentSize(const EphemerisHeader *header)
+{
+	return (size_t) (header -> Degree + 1) * COMPONENTS * header -> BodiesNumber;
+}
+
+
+static uint64_t ephemerisKey(Body **massive, const EphemerisHeader *header)
+{
+	uint64_t hash = HASH_INIT;
+
+	hashBytes(&hash, &header -> BodiesNumber, sizeof(int32_t));
+	hashBytes(&hash, &header -> Degree, sizeof(int32_t));
+	hashBytes(&hash, &header -> SegmentsNumber, sizeof(int32_t));
+	hashBytes(&hash, &header -> StartTime, sizeof(double));
+	hashBytes(&hash, &header -> SegmentDuration, sizeof(double));
+
+	int settings[] = {EPHEMERIS_SEGMENT_STEPS, getSubsteps(), INTEGRATOR, WH_STEPS_PER_FRAME, GRAVITY_SOLVER, CHEAT,
+		ADAPTIVE_SUBSTEPS, ADAPTIVE_MIN_SUBSTEPS, ADAPTIVE_MAX_SUBSTEPS};
+	hashBytes(&hash, settings, sizeof(settings));
+
+	double tolerance = ADAPTIVE_TOLERANCE;
+	hashBytes(&hash, &tolerance, sizeof(double));
+
+	for (int b = 0; b < header -> BodiesNumber; ++b)
+	{
+		const BodyState *state = massive[b] -> State;
+
+		double values[] = {massive[b] -> Mass, state -> Radius, state -> PosX, state -> PosY,
+			state -> SpeedX, state -> SpeedY};
+
+		hashBytes(&hash, massive[b] -> Name, strlen(massive[b] -> Name));
+		hashBytes(&hash, values, sizeof(values));
+	}
+
+	return hash;
+}
+
+
+// Least squares fit of a Chebyshev series of the given degree, to samples evenly spaced over [-1, 1].
+// The samples abscissas being the same for each segment, the fit is a fixed linear map, stored in 'fit' as
+// a (degree + 1) x (samples_number) matrix. Its normal equations are solved by Gauss-Jordan elimination:
+static void fitMatrix(double *fit, int degree, int samples_number)
+{
+	int width = degree + 1, row_size = width + samples_number;
+
+	double *chebyshev = (double*) calloc(samples_number * width, sizeof(double));
+	double *system = (double*) calloc(width * row_size, sizeof(double));
+
+	if (chebyshev == NULL || system == NULL)
+	{
+		printf("\nNot enough memory for the ephemeris.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int k = 0; k < samples_number; ++k)
+	{
+		double tau = -1. + 2. * k / (samples_number - 1);
+		double *row = chebyshev + k * width;
+
+		row[0] = 1.;
+
+		if (degree > 0)
+			row[1] = tau;
+
+		for (int n = 2; n <= degree; ++n)
+			row[n] = 2. * tau * row[n - 1] - row[n - 2];
+	}
+
+	// [A^T A | A^T], A being the Chebyshev polynomials at the samples abscissas:
+
+	for (int n = 0; n < width; ++n)
+	{
+		double *row = system + n * row_size;
+
+		for (int k = 0; k < samples_number; ++k)
+		{
+			double value = chebyshev[k * width + n];
+
+			for (int m = 0; m < width; ++m)
+				row[m] += value * chebyshev[k * width + m];
+
+			row[width + k] = value;
+		}
+	}
+
+	for (int n = 0; n < width; ++n)
+	{
+		int pivot = n;
+
+		for (int m = n + 1; m < width; ++m)
+		{
+			if (fabs(system[m * row_size + n]) > fabs(system[pivot * row_size + n]))
+				pivot = m;
+		}
+
+		for (int c = 0; c < row_size; ++c)
+		{
+			double value = system[n * row_size + c];
+			system[n * row_size + c] = system[pivot * row_size + c];
+			system[pivot * row_size + c] = value;
+		}
+
+		double inverse = 1. / system[n * row_size + n];
+
+		for (int c = 0; c < row_size; ++c)
+			system[n * row_size + c] *= inverse;
+
+		for (int m = 0; m < width; ++m)
+		{
+			double factor = system[m * row_size + n];
+
+			if (m == n || factor == 0.)
+				continue;
+
+			for (int c = 0; c < row_size; ++c)
+				system[m * row_size + c] -= factor * system[n * row_size + c];
+		}
+	}
+
+	for (int n = 0; n < width; ++n)
+		memcpy(fit + n * samples_number, system + n * row_size + width, samples_number * sizeof(double));
+
+	free(chebyshev);
+	free(system);
+}
+
+
+// Chebyshev coefficients of the derivative of a series, its coefficients being 'stride' apart.
+// 'scale' is the derivative of the Chebyshev variable with respect to time:
+static void deriveSeries(const double *series, double *derivative, int degree, int stride, double scale)
+{
+	double next = 0., next_next = 0.; // Coefficients of degree n + 1 and n + 2 of the derivative.
+
+	for (int n = degree; n >= 1; --n)
+	{
+		double coefficient = next_next + 2. * n * series[n * stride];
+
+		derivative[(n - 1) * stride] = scale * (n == 1 ? 0.5 * coefficient : coefficient);
+
+		next_next = next;
+		next = coefficient;
+	}
+
+	derivative[degree * stride] = 0.;
+}
+
+
+// Runs the physics on the massive bodies only, sampling their states EPHEMERIS_SEGMENT_STEPS times per segment,
+// and fits each segment. Collisions are disabled meanwhile, and the substeps restored afterwards. Returns the
+// coefficients, to be freed:
+static double* computeEphemeris(Body **massive, const EphemerisHeader *header)
+{
+	int bodies_number = header -> BodiesNumber, degree = header -> Degree;
+	int samples_number = EPHEMERIS_SEGMENT_STEPS + 1;
+	size_t segment_size = segmentSize(header);
+
+	double *coefficients = (double*) calloc(segment_size * header -> SegmentsNumber, sizeof(double));
+	double *samples = (double*) calloc((size_t) samples_number * FITTED_COMPONENTS * bodies_number, sizeof(double));
+	double *fit = (double*) calloc((degree + 1) * samples_number, sizeof(double));
+	BodyState *saved_states = (BodyState*) calloc(bodies_number, sizeof(BodyState));
+	double *saved_positions = (double*) calloc(2 * bodies_number, sizeof(double));
+
+	if (coefficients == NULL || samples == NULL || fit == NULL || saved_states == NULL || saved_positions == NULL)
+	{
+		printf("\nNot enough memory for the ephemeris.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fitMatrix(fit, degree, samples_number);
+
+	for (int b = 0; b < bodies_number; ++b)
+	{
+		memcpy(saved_states + b, massive[b] -> State, sizeof(BodyState));
+		saved_positions[2 * b] = massive[b] -> PrevPosX;
+		saved_positions[2 * b + 1] = massive[b] -> PrevPosY;
+	}
+
+	int collisions_enabled = CollisionsEnabled;
+	CollisionsEnabled = 0;
+
+	// The substeps adapt to the precomputed trajectories, the live run must not start from them:
+	int target_substeps = getTargetSubsteps();
+
+	double speed_scale = 2. / header -> SegmentDuration;
+
+	for (int s = 0; s < header -> SegmentsNumber; ++s)
+	{
+		// The first sample of a segment is the last one of the previous segment:
+
+		for (int k = 0; k < samples_number; ++k)
+		{
+			if (k > 0)
+				moveBodies(massive, bodies_number, NULL, NULL, 0.);
+
+			double *sample = samples + (size_t) k * FITTED_COMPONENTS * bodies_number;
+
+			for (int b = 0; b < bodies_number; ++b)
+			{
+				sample[b] = massive[b] -> State -> PosX;
+				sample[bodies_number + b] = massive[b] -> State -> PosY;
+				sample[2 * bodies_number + b] = massive[b] -> State -> SpeedX;
+				sample[3 * bodies_number + b] = massive[b] -> State -> SpeedY;
+			}
+		}
+
+		double *segment = coefficients + s * segment_size;
+		int fitted_width = FITTED_COMPONENTS * bodies_number, width = COMPONENTS * bodies_number;
+
+		for (int n = 0; n <= degree; ++n)
+		{
+			for (int k = 0; k < samples_number; ++k)
+			{
+				double weight = fit[n * samples_number + k];
+				const double *sample = samples + (size_t) k * fitted_width;
+
+				for (int i = 0; i < fitted_width; ++i)
+					segment[n * width + i] += weight * sample[i];
+			}
+		}
+
+		// Accelerations, from the speeds series:
+
+		for (int i = 2 * bodies_number; i < fitted_width; ++i)
+			deriveSeries(segment + i, segment + 2 * bodies_number + i, degree, width, speed_scale);
+	}
+
+	CollisionsEnabled = collisions_enabled;
+	setTargetSubsteps(target_substeps);
+
+	for (int b = 0; b < bodies_number; ++b)
+	{
+		memcpy(massive[b] -> State, saved_states + b, sizeof(BodyState));
+		massive[b] -> PrevPosX = saved_positions[2 * b];
+		massive[b] -> PrevPosY = saved_positions[2 * b + 1];
+	}
+
+	free(samples);
+	free(fit);
+	free(saved_states);
+	free(saved_positions);
+
+	return coefficients;
+}
+
+
+// Maps the ephemeris file if it matches the given header. Returns 1 on success, 0 otherwise:
+static int mapEphemeris(const char *path, const EphemerisHeader *header)
+{
+	int file = open(path, O_RDONLY);
+
+	if (file == -1)
+		return 0;
+
+	struct stat file_stat;
+	size_t size = sizeof(EphemerisHeader) + segmentSize(header) * header -> SegmentsNumber * sizeof(double);
+
+	if (fstat(file, &file_stat) != 0 || (size_t) file_stat.st_size != size)
+	{
+		close(file);
+		return 0;
+	}
+
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+	close(file); // The mapping stays valid.
+
+	if (mapping == MAP_FAILED)
+		return 0;
+
+	if (memcmp(mapping, header, sizeof(EphemerisHeader)) != 0)
+	{
+		munmap(mapping, size);
+		return 0;
+	}
+
+	Mapping = mapping;
+	MappingSize = size;
+	Coefficients = (const double*) ((const char*) mapping + sizeof(EphemerisHeader));
+
+	return 1;
+}
+
+
+// Returns 1 on success, 0 otherwise:
+static int writeEphemeris(const char *path, const EphemerisHeader *header, const double *coefficients)
+{
+	FILE *file = fopen(path, "wb");
+
+	if (file == NULL)
+		return 0;
+
+	size_t number = segmentSize(header) * header -> SegmentsNumber;
+
+	int success = fwrite(header, sizeof(EphemerisHeader), 1, file) == 1 &&
+		fwrite(coefficients, sizeof(double), number, file) == number;
+
+	success = fclose(file) == 0 && success;
+
+	if (!success)
+		remove(path);
+
+	return success;
+}
+
+
+// Precomputes with the physics engine the trajectories of the massive bodies, over EPHEMERIS_DAYS simulated days,
+// as piecewise Chebyshev series stored in EPHEMERIS_FILE. The file is memory-mapped, and only recomputed if
+// the simulation or the settings it depends on have changed. Bodies states are restored afterwards.
+// Returns 1 if the ephemeris is in use, 0 otherwise:
+int initEphemeris(Body **bodies, int bodies_number)
+{
+	freeEphemerisResources();
+
+	Body **massive = (Body**) calloc(bodies_number, sizeof(Body*));
+
+	if (massive == NULL)
+	{
+		printf("\nNot enough memory for the ephemeris.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	int massive_number = 0;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		if (bodies[i] != NULL && !isTestParticle(bodies[i]))
+			massive[massive_number++] = bodies[i];
+	}
+
+	if (massive_number == 0)
+	{
+		free(massive);
+		return 0;
+	}
+
+	memset(&Header, 0, sizeof(EphemerisHeader));
+	memcpy(Header.Magic, MAGIC, sizeof(Header.Magic));
+
+	Header.BodiesNumber = massive_number;
+	Header.Degree = MIN(EPHEMERIS_DEGREE, EPHEMERIS_SEGMENT_STEPS);
+	Header.StartTime = getSimulationTime();
+	Header.SegmentDuration = EPHEMERIS_SEGMENT_STEPS * getStepDuration();
+	Header.SegmentsNumber = MAX(1, (int) ceil(EPHEMERIS_DAYS * 24. * 3600. / Header.SegmentDuration));
+	Header.Key = ephemerisKey(massive, &Header);
+
+	double start = realTime();
+
+	if (mapEphemeris(EPHEMERIS_FILE, &Header))
+		printf("Ephemeris loaded from '%s'.\n", EPHEMERIS_FILE);
+
+	else
+	{
+		double *coefficients = computeEphemeris(massive, &Header);
+
+		if (writeEphemeris(EPHEMERIS_FILE, &Header, coefficients) && mapEphemeris(EPHEMERIS_FILE, &Header))
+		{
+			free(coefficients);
+			printf("Ephemeris computed, and saved in '%s'.\n", EPHEMERIS_FILE);
+		}
+
+		else
+		{
+			OwnedCoefficients = coefficients;
+			Coefficients = coefficients;
+			printf("Ephemeris computed, but it could not be saved in '%s'.\n", EPHEMERIS_FILE);
+		}
+	}
+
+	printf("%d massive bodies over %.1f days, in %.3f s.\n\n", massive_number,
+		Header.SegmentsNumber * Header.SegmentDuration / (24. * 3600.), realTime() - start);
+
+	Handles = (BodyHandle*) calloc(massive_number, sizeof(BodyHandle));
+	Values = (double*) calloc(COMPONENTS * massive_number, sizeof(double));
+
+	if (Handles == NULL || Values == NULL)
+	{
+		printf("\nNot enough memory for the ephemeris.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int b = 0; b < massive_number; ++b)
+		Handles[b] = getBodyHandle(massive[b]);
+
+	free(massive);
+
+	EphemerisOn = 1;
+
+	return 1;
+}
+
+
+int isEphemerisOn(void)
+{
+	return EphemerisOn;
+}
+
+
+// Returns 1 if the given simulation time is covered by the ephemeris, 0 otherwise:
+int ephemerisCovers(double time)
+{
+	double position = (time - Header.StartTime) / Header.SegmentDuration;
+
+	return EphemerisOn && position >= 0. && position <= Header.SegmentsNumber;
+}
+
+
+// Sets the positions, speeds and accelerations of the massive bodies at the given simulation time, interpolated
+// from the ephemeris. Returns 0 if this time isn't covered, 1 otherwise:
+int applyEphemeris(double time)
+{
+	if (!ephemerisCovers(time))
+		return 0;
+
+	double position = (time - Header.StartTime) / Header.SegmentDuration;
+	int segment = MIN((int) position, Header.SegmentsNumber - 1);
+	double tau = 2. * (position - segment) - 1.;
+
+	int degree = Header.Degree, bodies_number = Header.BodiesNumber;
+	int width = COMPONENTS * bodies_number;
+
+	Chebyshev[0] = 1.;
+
+	if (degree > 0)
+		Chebyshev[1] = tau;
+
+	for (int n = 2; n <= degree; ++n)
+		Chebyshev[n] = 2. * tau * Chebyshev[n - 1] - Chebyshev[n - 2];
+
+	const double *coefficients = Coefficients + segment * segmentSize(&Header);
+
+	memcpy(Values, coefficients, width * sizeof(double));
+
+	for (int n = 1; n <= degree; ++n)
+	{
+		double chebyshev = Chebyshev[n];
+		const double *series = coefficients + n * width;
+
+		#pragma omp simd
+		for (int i = 0; i < width; ++i)
+			Values[i] += chebyshev * series[i];
+	}
+
+	for (int b = 0; b < bodies_number; ++b)
+	{
+		Body *body = getBody(Handles[b]);
+
+		if (body == NULL)
+			continue;
+
+		BodyState *state = body -> State;
+
+		state -> PosX = Values[b];
+		state -> PosY = Values[bodies_number + b];
+		state -> SpeedX = Values[2 * bodies_number + b];
+		state -> SpeedY = Values[3 * bodies_number + b];
+		state -> AccelX = Values[4 * bodies_number + b];
+		state -> AccelY = Values[5 * bodies_number + b];
+	}
+
+	return 1;
+}
+
+
+// Stops using the ephemeris. To be done upon exit too.
+void freeEphemerisResources(void)
+{
+	if (Mapping != NULL)
+		munmap(Mapping, MappingSize);
+
+	free(OwnedCoefficients);
+	free(Handles);
+	free(Values);
+
+	Mapping = NULL;
+	MappingSize = 0;
+	OwnedCoefficients = NULL;
+	Coefficients = NULL;
+	Handles = NULL;
+	Values = NULL;
+	EphemerisOn = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+
+
+#include "bodies.h"
+
+
+// Precomputes with the physics engine the trajectories of the massive bodies, over EPHEMERIS_DAYS simulated days,
+// as piecewise Chebyshev series stored in EPHEMERIS_FILE. The file is memory-mapped, and only recomputed if
+// the simulation or the settings it depends on have changed. Bodies states are restored afterwards.
+// Returns 1 if the ephemeris is in use, 0 otherwise:
+int initEphemeris(Body **bodies, int bodies_number);
+
+
+int isEphemerisOn(void);
+
+
+// Returns 1 if the given simulation time is covered by the ephemeris, 0 otherwise:
+int ephemerisCovers(double time);
+
+
+// Sets the positions, speeds and accelerations of the massive bodies at the given simulation time, interpolated
+// from the ephemeris. Returns 0 if this time isn't covered, 1 otherwise:
+int applyEphemeris(double time);
+
+
+// Stops using the ephemeris. To be done upon exit too.
+void freeEphemerisResources(void);
+
+
+#endif
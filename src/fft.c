@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "settings.h"
+#include "fft.h"
+
+
+#define PI 3.14159265358979323846
+
+
+#ifdef ENABLE_MULTITHREADING
+	#define FFT_THREADS THREAD_NUMBER
+#else
+	#define FFT_THREADS 1
+#endif
+
+
+// Tables for the current size, computed once:
+static int Size = 0;
+static double complex *Twiddles = NULL; // exp(-2 i pi k / Size), for k < Size / 2.
+static int *BitReversed = NULL;
+
+static double complex *Columns = NULL; // One column buffer per thread.
+
+
+static void initTables(int size)
+{
+	if (size == Size)
+		return;
+
+	freeFFTResources();
+
+	Twiddles = (double complex*) calloc(size / 2 + 1, sizeof(double complex));
+	BitReversed = (int*) calloc(size, sizeof(int));
+	Columns = (double complex*) calloc((size_t) FFT_THREADS * size, sizeof(double complex));
+
+	if (Twiddles == NULL || BitReversed == NULL || Columns == NULL)
+	{
+		printf("\nNot enough memory for the FFT tables.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int k = 0; k < size / 2; ++k)
+		Twiddles[k] = cexp(-2. * PI * I * k / size);
+
+	int bits = 0;
+
+	while ((1 << bits) < size)
+		++bits;
+
+	for (int i = 0; i < size; ++i)
+	{
+		int reversed = 0;
+
+		for (int b = 0; b < bits; ++b)
+			reversed |= ((i >> b) & 1) << (bits - 1 - b);
+
+		BitReversed[i] = reversed;
+	}
+
+	Size = size;
+}
+
+
+// Iterative radix-2 Cooley-Tukey FFT of 'Size' contiguous values:
+static void fft1d(double complex *data, int inverse)
+{
+	for (int i = 0; i < Size; ++i)
+	{
+		int j = BitReversed[i];
+
+		if (i < j)
+		{
+			double complex temp = data[i];
+			data[i] = data[j];
+			data[j] = temp;
+		}
+	}
+
+	for (int length = 2; length <= Size; length *= 2)
+	{
+		int half = length / 2, step = Size / length;
+
+		for (int start = 0; start < Size; start += length)
+		{
+			for (int k = 0; k < half; ++k)
+			{
+				double complex w = inverse ? conj(Twiddles[k * step]) : Twiddles[k * step];
+
+				double complex even = data[start + k];
+				double complex odd = w * data[start + k + half];
+
+				data[start + k] = even + odd;
+				data[start + k + half] = even - odd;
+			}
+		}
+	}
+}
+
+
+// In-place 2D FFT of a size x size row-major complex array, 'size' being a power of 2. Rows, then columns,
+// are transformed in parallel. If 'inverse' is set, the inverse transform is computed, without the 1 / size^2 factor.
+void fft2d(double complex *data, int size, int inverse)
+{
+	if (size < 2 || (size & (size - 1)) != 0)
+	{
+		printf("\nFFT size must be a power of 2, got %d.\n", size);
+		exit(EXIT_FAILURE);
+	}
+
+	initTables(size);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(FFT_THREADS)
+	#endif
+	for (int row = 0; row < size; ++row)
+		fft1d(data + (size_t) row * size, inverse);
+
+	// Columns are copied in a contiguous buffer, for each thread to work on its own:
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(FFT_THREADS)
+	#endif
+	for (int t = 0; t < FFT_THREADS; ++t)
+	{
+		double complex *column = Columns + (size_t) t * size;
+
+		for (int col = t; col < size; col += FFT_THREADS)
+		{
+			for (int row = 0; row < size; ++row)
+				column[row] = data[(size_t) row * size + col];
+
+			fft1d(column, inverse);
+
+			for (int row = 0; row < size; ++row)
+				data[(size_t) row * size + col] = column[row];
+		}
+	}
+}
+
+
+// To be done upon exit.
+void freeFFTResources(void)
+{
+	free(Twiddles);
+	free(BitReversed);
+	free(Columns);
+
+	Twiddles = NULL;
+	BitReversed = NULL;
+	Columns = NULL;
+
+	Size = 0;
+}
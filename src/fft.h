@@ -0,0 +1,17 @@
+#ifndef FFT_H
+#define FFT_H
+
+
+#include <complex.h>
+
+
+// In-place 2D FFT of a size x size row-major complex array, 'size' being a power of 2. Rows, then columns,
+// are transformed in parallel. If 'inverse' is set, the inverse transform is computed, without the 1 / size^2 factor.
+void fft2d(double complex *data, int size, int inverse);
+
+
+// To be done upon exit.
+void freeFFTResources(void);
+
+
+#endif
@@ -0,0 +1,701 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include "settings.h"
+#include "fmm.h"
+#include "physics.h"
+#include "simulations.h"
+
+
+#ifdef ENABLE_MULTITHREADING
+	#define FMM_THREADS THREAD_NUMBER
+#else
+	#define FMM_THREADS 1
+#endif
+
+#define MAX_LEVEL 10 // Leaves are at most at this level, the root being at level 0.
+#define VALIDATION_MAX_ORDER 16
+
+
+// Gravity is the one of 3D space, the potential of a body of unit 'GravityFactor' at w being -1 / |z - w|.
+// This is not an analytic function of z, hence expansions are done in both z and conj(z):
+//
+// 1 / |z - w| = sum over k, l of c_k c_l w^k conj(w)^l / (z^k conj(z)^l |z|), with c_n = binomial(2n, n) / 4^n.
+//
+// Expansions hold the terms k + l <= Order, and are stored as (Order + 1)^2 arrays, at index k * (Order + 1) + l.
+// Multipole expansions: M_kl = sum of g (w - c)^k conj(w - c)^l over the bodies of a cell of center c.
+// Local expansions: the potential at c + u is the sum of L_ab u^a conj(u)^b.
+
+static int Order = FMM_ORDER;
+static int Width = FMM_ORDER + 1; // Order + 1.
+
+static double *Binomials = NULL; // Binomials[n * (2 Order + 1) + k] = binomial(n, k), n <= 2 Order.
+static double *SeriesFactors = NULL; // c_n, n <= 2 Order.
+
+// Uniform quadtree, cells being stored level by level, in row-major order:
+static int LeafLevel = 0;
+static double OriginX = 0., OriginY = 0., Size = 1.;
+
+static double complex *Multipoles = NULL;
+static double complex *Locals = NULL;
+static int *CellCounts = NULL;
+static int CellsCapacity = 0; // In expansion terms.
+
+// Multipole to local translations only depend on the offset between the cells, in [-3, 3]^2 at a given level:
+#define OFFSETS_NUMBER 49
+static double complex *Translations = NULL; // U matrices, see multipoleToLocal(), per level and offset.
+static double *TranslationScales = NULL; // 1 / |z0|.
+static int TranslationLevels = 0;
+
+static int *LeafStarts = NULL; // Bodies of a leaf are Sorted[LeafStarts[leaf]] to Sorted[LeafStarts[leaf + 1] - 1].
+static int *Sorted = NULL;
+static int *BodyLeaves = NULL;
+static int LeavesCapacity = 0;
+static int SortedCapacity = 0;
+
+
+static void* allocate(size_t number, size_t size)
+{
+	void *memory = calloc(number, size);
+
+	if (memory == NULL)
+	{
+		printf("\nNot enough memory for the FMM tree.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return memory;
+}
+
+
+static void initTables(void)
+{
+	if (Binomials != NULL)
+		return;
+
+	int n_max = 2 * Order;
+
+	Binomials = (double*) allocate((n_max + 1) * (n_max + 1), sizeof(double));
+	SeriesFactors = (double*) allocate(n_max + 1, sizeof(double));
+
+	for (int n = 0; n <= n_max; ++n)
+	{
+		Binomials[n * (n_max + 1)] = 1.;
+
+		for (int k = 1; k <= n; ++k)
+			Binomials[n * (n_max + 1) + k] = Binomials[(n - 1) * (n_max + 1) + k - 1]
+				+ (k < n ? Binomials[(n - 1) * (n_max + 1) + k] : 0.);
+
+		SeriesFactors[n] = n == 0 ? 1. : SeriesFactors[n - 1] * (2. * n - 1.) / (2. * n);
+	}
+}
+
+
+static inline double binomial(int n, int k)
+{
+	return Binomials[n * (2 * Order + 1) + k];
+}
+
+
+static inline int levelOffset(int level)
+{
+	return ((1 << (2 * level)) - 1) / 3;
+}
+
+
+static inline double complex cellCenter(int level, int x, int y)
+{
+	double width = Size / (1 << level);
+
+	return OriginX + (x + 0.5) * width + I * (OriginY + (y + 0.5) * width);
+}
+
+
+// out[n] = z^n, for n <= max:
+static inline void powers(double complex z, int max, double complex *out)
+{
+	out[0] = 1.;
+
+	for (int n = 1; n <= max; ++n)
+		out[n] = out[n - 1] * z;
+}
+
+
+// Sorts the bodies in the leaves of a tree covering them, whose depth depends on their number:
+static void buildTree(BodyState **states, int number)
+{
+	double xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY;
+
+	for (int i = 0; i < number; ++i)
+	{
+		if (states[i] == NULL)
+			continue;
+
+		xmin = MIN(xmin, states[i] -> PosX);
+		xmax = MAX(xmax, states[i] -> PosX);
+		ymin = MIN(ymin, states[i] -> PosY);
+		ymax = MAX(ymax, states[i] -> PosY);
+	}
+
+	double extent = MAX(xmax - xmin, ymax - ymin);
+
+	Size = extent > 0. ? extent * (1. + 1e-9) : 1.;
+	OriginX = xmin;
+	OriginY = ymin;
+
+	LeafLevel = 2;
+
+	while (LeafLevel < MAX_LEVEL && (double) FMM_LEAF_SIZE * (1 << (2 * LeafLevel)) < number)
+		++LeafLevel;
+
+	int side = 1 << LeafLevel, leaves = side * side;
+	int cells = levelOffset(LeafLevel + 1);
+
+	if (cells * Width * Width > CellsCapacity)
+	{
+		free(Multipoles);
+		free(Locals);
+		free(CellCounts);
+
+		CellsCapacity = cells * Width * Width;
+
+		Multipoles = (double complex*) allocate(CellsCapacity, sizeof(double complex));
+		Locals = (double complex*) allocate(CellsCapacity, sizeof(double complex));
+		CellCounts = (int*) allocate(cells, sizeof(int));
+	}
+
+	if (leaves + 1 > LeavesCapacity)
+	{
+		free(LeafStarts);
+
+		LeavesCapacity = leaves + 1;
+		LeafStarts = (int*) allocate(LeavesCapacity, sizeof(int));
+	}
+
+	if (number > SortedCapacity)
+	{
+		free(Sorted);
+		free(BodyLeaves);
+
+		SortedCapacity = number;
+		Sorted = (int*) allocate(SortedCapacity, sizeof(int));
+		BodyLeaves = (int*) allocate(SortedCapacity, sizeof(int));
+	}
+
+	// Counting sort of the bodies by leaf:
+
+	memset(CellCounts, 0, cells * sizeof(int));
+
+	int *leaf_counts = CellCounts + levelOffset(LeafLevel);
+	double leaf_width = Size / side;
+
+	for (int i = 0; i < number; ++i)
+	{
+		if (states[i] == NULL)
+		{
+			BodyLeaves[i] = -1;
+			continue;
+		}
+
+		int x = MIN((int) ((states[i] -> PosX - OriginX) / leaf_width), side - 1);
+		int y = MIN((int) ((states[i] -> PosY - OriginY) / leaf_width), side - 1);
+
+		BodyLeaves[i] = y * side + x;
+		++leaf_counts[BodyLeaves[i]];
+	}
+
+	// Leaves ends first, decreased down to the leaves starts while filling them:
+
+	int end = 0;
+
+	for (int leaf = 0; leaf < leaves; ++leaf)
+	{
+		end += leaf_counts[leaf];
+		LeafStarts[leaf] = end;
+	}
+
+	LeafStarts[leaves] = end;
+
+	for (int i = number - 1; i >= 0; --i)
+	{
+		if (BodyLeaves[i] != -1)
+			Sorted[--LeafStarts[BodyLeaves[i]]] = i;
+	}
+
+	// Bodies number of the upper cells, empty cells being skipped:
+
+	for (int level = LeafLevel - 1; level >= 0; --level)
+	{
+		int level_side = 1 << level;
+
+		for (int y = 0; y < level_side; ++y)
+		{
+			for (int x = 0; x < level_side; ++x)
+			{
+				int *children = CellCounts + levelOffset(level + 1);
+				int child = 2 * y * 2 * level_side + 2 * x;
+
+				CellCounts[levelOffset(level) + y * level_side + x] = children[child] + children[child + 1]
+					+ children[child + 2 * level_side] + children[child + 2 * level_side + 1];
+			}
+		}
+	}
+}
+
+
+// Multipole expansions of the leaves:
+static void leavesMultipoles(BodyState **states)
+{
+	int side = 1 << LeafLevel, offset = levelOffset(LeafLevel);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(FMM_THREADS) schedule(dynamic, 16)
+	#endif
+	for (int leaf = 0; leaf < side * side; ++leaf)
+	{
+		double complex *multipole = Multipoles + (size_t) (offset + leaf) * Width * Width;
+		double complex center = cellCenter(LeafLevel, leaf % side, leaf / side);
+		double complex zp[Width], cp[Width];
+
+		memset(multipole, 0, Width * Width * sizeof(double complex));
+
+		for (int s = LeafStarts[leaf]; s < LeafStarts[leaf + 1]; ++s)
+		{
+			BodyState *state = states[Sorted[s]];
+
+			double complex d = state -> PosX + I * state -> PosY - center;
+
+			powers(d, Order, zp);
+			powers(conj(d), Order, cp);
+
+			for (int k = 0; k <= Order; ++k)
+			{
+				for (int l = 0; l <= Order - k; ++l)
+					multipole[k * Width + l] += state -> GravityFactor * zp[k] * cp[l];
+			}
+		}
+	}
+}
+
+
+// Multipole expansions of the cells of the given level, from the ones of their children:
+static void upwardPass(int level)
+{
+	int side = 1 << level, offset = levelOffset(level), child_offset = levelOffset(level + 1);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(FMM_THREADS) schedule(dynamic, 16)
+	#endif
+	for (int cell = 0; cell < side * side; ++cell)
+	{
+		double complex *multipole = Multipoles + (size_t) (offset + cell) * Width * Width;
+		double complex center = cellCenter(level, cell % side, cell / side);
+		double complex zp[Width], cp[Width];
+
+		memset(multipole, 0, Width * Width * sizeof(double complex));
+
+		if (CellCounts[offset + cell] == 0)
+			continue;
+
+		for (int c = 0; c < 4; ++c)
+		{
+			int x = 2 * (cell % side) + c % 2, y = 2 * (cell / side) + c / 2;
+			int child = child_offset + y * 2 * side + x;
+
+			if (CellCounts[child] == 0)
+				continue;
+
+			double complex *source = Multipoles + (size_t) child * Width * Width;
+			double complex d = cellCenter(level + 1, x, y) - center;
+
+			powers(d, Order, zp);
+			powers(conj(d), Order, cp);
+
+			// (w - c) = (w - c_child) + d, expanded with the binomial formula:
+
+			for (int k = 0; k <= Order; ++k)
+			{
+				for (int l = 0; l <= Order - k; ++l)
+				{
+					double complex sum = 0.;
+
+					for (int a = 0; a <= k; ++a)
+					{
+						for (int b = 0; b <= l; ++b)
+							sum += binomial(k, a) * binomial(l, b) * zp[k - a] * cp[l - b] * source[a * Width + b];
+					}
+
+					multipole[k * Width + l] += sum;
+				}
+			}
+		}
+	}
+}
+
+
+// Multipole to local translation, 'z0' being the local center minus the multipole center. The expansion of
+// (z0 + u)^(-k - 1/2) conj(z0 + u)^(-l - 1/2) gives:
+//
+// L_ab = -(-1)^(a + b) / |z0| * sum of M_kl U_ak conj(U_bl), with U_ak = binomial(k + a, a) c_(k + a) / z0^(k + a).
+//
+// U only depends on z0, and is stored for every level and offset:
+static void initTranslations(void)
+{
+	if (LeafLevel + 1 > TranslationLevels)
+	{
+		free(Translations);
+		free(TranslationScales);
+
+		TranslationLevels = LeafLevel + 1;
+
+		Translations = (double complex*) allocate((size_t) TranslationLevels * OFFSETS_NUMBER * Width * Width,
+			sizeof(double complex));
+		TranslationScales = (double*) allocate(TranslationLevels * OFFSETS_NUMBER, sizeof(double));
+	}
+
+	double complex inverse_powers[2 * Width];
+
+	for (int level = 2; level <= LeafLevel; ++level)
+	{
+		double width = Size / (1 << level);
+
+		for (int offset = 0; offset < OFFSETS_NUMBER; ++offset)
+		{
+			double complex z0 = width * ((offset % 7 - 3) + I * (offset / 7 - 3));
+
+			if (z0 == 0.)
+				continue;
+
+			double complex *u = Translations + ((size_t) level * OFFSETS_NUMBER + offset) * Width * Width;
+
+			powers(1. / z0, 2 * Order, inverse_powers);
+
+			for (int a = 0; a <= Order; ++a)
+			{
+				for (int k = 0; k <= Order; ++k)
+					u[a * Width + k] = binomial(k + a, a) * SeriesFactors[k + a] * inverse_powers[k + a];
+			}
+
+			TranslationScales[level * OFFSETS_NUMBER + offset] = 1. / cabs(z0);
+		}
+	}
+}
+
+
+// Adds to a local expansion the one of a multipole expansion, with the given translation. The sum is separable,
+// and computed in Order^3 operations. Local expansions are real valued, hence L_ba = conj(L_ab):
+static void multipoleToLocal(const double complex *multipole, double complex *local, const double complex *u, double scale)
+{
+	double complex w[Width * Width];
+
+	// w_kb = sum over l of M_kl conj(U_bl):
+
+	for (int k = 0; k <= Order; ++k)
+	{
+		for (int b = 0; b <= Order; ++b)
+		{
+			double complex sum = 0.;
+
+			for (int l = 0; l <= Order - k; ++l)
+				sum += multipole[k * Width + l] * conj(u[b * Width + l]);
+
+			w[k * Width + b] = sum;
+		}
+	}
+
+	for (int a = 0; a <= Order; ++a)
+	{
+		for (int b = a; b <= Order - a; ++b)
+		{
+			double complex sum = 0.;
+
+			for (int k = 0; k <= Order; ++k)
+				sum += u[a * Width + k] * w[k * Width + b];
+
+			sum *= (a + b) % 2 == 0 ? -scale : scale;
+
+			local[a * Width + b] += sum;
+
+			if (b != a)
+				local[b * Width + a] += conj(sum);
+		}
+	}
+}
+
+
+// Local expansions of the cells of the given level, from the multipoles of well separated cells whose parents
+// neighbour their parent, i.e. the interaction list. Then shifted and added to the local expansions of the children.
+static void downwardPass(int level)
+{
+	int side = 1 << level, offset = levelOffset(level);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(FMM_THREADS) schedule(dynamic, 16)
+	#endif
+	for (int cell = 0; cell < side * side; ++cell)
+	{
+		if (CellCounts[offset + cell] == 0)
+			continue;
+
+		int x = cell % side, y = cell / side;
+
+		double complex *local = Locals + (size_t) (offset + cell) * Width * Width;
+
+		int x_min = MAX(0, 2 * (x / 2 - 1)), x_max = MIN(side - 1, 2 * (x / 2 + 1) + 1);
+		int y_min = MAX(0, 2 * (y / 2 - 1)), y_max = MIN(side - 1, 2 * (y / 2 + 1) + 1);
+
+		for (int sy = y_min; sy <= y_max; ++sy)
+		{
+			for (int sx = x_min; sx <= x_max; ++sx)
+			{
+				int source = offset + sy * side + sx;
+
+				if ((abs(sx - x) <= 1 && abs(sy - y) <= 1) || CellCounts[source] == 0)
+					continue;
+
+				int translation = level * OFFSETS_NUMBER + (y - sy + 3) * 7 + x - sx + 3;
+
+				multipoleToLocal(Multipoles + (size_t) source * Width * Width, local,
+					Translations + (size_t) translation * Width * Width, TranslationScales[translation]);
+			}
+		}
+	}
+
+	if (level == LeafLevel)
+		return;
+
+	// Shifting to the children centers, with the binomial formula:
+
+	int child_side = 2 * side, child_offset = levelOffset(level + 1);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(FMM_THREADS) schedule(dynamic, 16)
+	#endif
+	for (int child = 0; child < child_side * child_side; ++child)
+	{
+		int x = child % child_side, y = child / child_side;
+
+		double complex *local = Locals + (size_t) (child_offset + child) * Width * Width;
+		double complex *parent = Locals + (size_t) (offset + (y / 2) * side + x / 2) * Width * Width;
+		double complex zp[Width], cp[Width];
+
+		memset(local, 0, Width * Width * sizeof(double complex));
+
+		if (CellCounts[child_offset + child] == 0)
+			continue;
+
+		double complex d = cellCenter(level + 1, x, y) - cellCenter(level, x / 2, y / 2);
+
+		powers(d, Order, zp);
+		powers(conj(d), Order, cp);
+
+		for (int a = 0; a <= Order; ++a)
+		{
+			for (int b = 0; b <= Order - a; ++b)
+			{
+				double complex sum = 0.;
+
+				for (int i = a; i <= Order; ++i)
+				{
+					for (int j = b; j <= Order - i; ++j)
+						sum += binomial(i, a) * binomial(j, b) * zp[i - a] * cp[j - b] * parent[i * Width + j];
+				}
+
+				local[a * Width + b] = sum;
+			}
+		}
+	}
+}
+
+
+// Accelerations of the bodies of each leaf, from its local expansion and from the bodies of the neighbouring leaves:
+static void leavesAccelerations(BodyState **states)
+{
+	int side = 1 << LeafLevel, offset = levelOffset(LeafLevel);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(FMM_THREADS) schedule(dynamic, 16)
+	#endif
+	for (int leaf = 0; leaf < side * side; ++leaf)
+	{
+		int x = leaf % side, y = leaf / side;
+
+		double complex *local = Locals + (size_t) (offset + leaf) * Width * Width;
+		double complex center = cellCenter(LeafLevel, x, y);
+		double complex zp[Width], cp[Width];
+
+		for (int s = LeafStarts[leaf]; s < LeafStarts[leaf + 1]; ++s)
+		{
+			BodyState *state = states[Sorted[s]];
+
+			// Far field: acceleration = -2 d(potential) / d(conj(u)):
+
+			double complex u = state -> PosX + I * state -> PosY - center;
+
+			powers(u, Order, zp);
+			powers(conj(u), Order, cp);
+
+			double complex accel = 0.;
+
+			for (int a = 0; a <= Order; ++a)
+			{
+				for (int b = 1; b <= Order - a; ++b)
+					accel += b * local[a * Width + b] * zp[a] * cp[b - 1];
+			}
+
+			double accel_x = -2. * creal(accel), accel_y = -2. * cimag(accel);
+
+			// Near field:
+
+			for (int ny = MAX(0, y - 1); ny <= MIN(side - 1, y + 1); ++ny)
+			{
+				for (int nx = MAX(0, x - 1); nx <= MIN(side - 1, x + 1); ++nx)
+				{
+					int neighbour = ny * side + nx;
+
+					for (int t = LeafStarts[neighbour]; t < LeafStarts[neighbour + 1]; ++t)
+					{
+						BodyState *other = states[Sorted[t]];
+
+						double dx = other -> PosX - state -> PosX;
+						double dy = other -> PosY - state -> PosY;
+
+						double dist = sqrt(dx * dx + dy * dy);
+						double dist_cubed = dist * dist * dist;
+
+						if (dist_cubed == 0.) // Including the body itself.
+							continue;
+
+						accel_x += other -> GravityFactor * dx / dist_cubed;
+						accel_y += other -> GravityFactor * dy / dist_cubed;
+					}
+				}
+			}
+
+			state -> AccelX = accel_x;
+			state -> AccelY = accel_y;
+		}
+	}
+}
+
+
+// Fast multipole method (FMM): bodies are sorted in a uniform quadtree, whose cells gather their bodies gravity
+// in multipole expansions. Those are converted into local expansions at well separated cells, which are passed down
+// the tree. Neighbouring leaves interact directly. The cost is linear in the number of bodies, and the accuracy
+// is set by the order of the expansions. NULL states are skipped, accelerations are overwritten.
+void computeAccelerationsFMM(BodyState **states, int number)
+{
+	initTables();
+
+	buildTree(states, number);
+
+	leavesMultipoles(states);
+
+	// Levels 0 and 1 have no well separated cells:
+
+	for (int level = LeafLevel - 1; level >= 2; --level)
+		upwardPass(level);
+
+	initTranslations();
+
+	memset(Locals + (size_t) levelOffset(2) * Width * Width, 0, 16 * Width * Width * sizeof(double complex));
+
+	for (int level = 2; level <= LeafLevel; ++level)
+		downwardPass(level);
+
+	leavesAccelerations(states);
+}
+
+
+// Sets the order of the multipole expansions, FMM_ORDER by default.
+void setFMMOrder(int order)
+{
+	if (order == Order || order < 1)
+		return;
+
+	freeFMMResources();
+
+	Order = order;
+	Width = order + 1;
+}
+
+
+// Compares the FMM accelerations of the given bodies to the direct sum for several orders, and prints the relative
+// errors along the computation times, i.e. the error versus time curve.
+void validateFMM(Body **bodies, int bodies_number)
+{
+	BodyState **states = (BodyState**) allocate(bodies_number, sizeof(BodyState*));
+	double *ax = (double*) allocate(bodies_number, sizeof(double));
+	double *ay = (double*) allocate(bodies_number, sizeof(double));
+
+	for (int i = 0; i < bodies_number; ++i)
+		states[i] = bodies[i] == NULL ? NULL : bodies[i] -> State;
+
+	double start = realTime();
+
+	directAccelerations(states, bodies_number, ax, ay);
+
+	printf("FMM validation, %d bodies. Direct sum: %.2f ms\n", bodies_number, 1000. * (realTime() - start));
+	printf("order   rms error   max error   time (ms)\n");
+
+	for (int order = 2; order <= VALIDATION_MAX_ORDER; order += 2)
+	{
+		setFMMOrder(order);
+
+		computeAccelerationsFMM(states, bodies_number); // Allocations are not timed.
+
+		start = realTime();
+
+		computeAccelerationsFMM(states, bodies_number);
+
+		double time = realTime() - start;
+
+		double rms_error, max_error;
+		accelerationErrors(states, bodies_number, ax, ay, &rms_error, &max_error);
+
+		printf("%5d   %9.2e   %9.2e   %9.2f\n", order, rms_error, max_error, 1000. * time);
+	}
+
+	printf("\n");
+
+	setFMMOrder(FMM_ORDER);
+
+	free(states);
+	free(ax);
+	free(ay);
+}
+
+
+// To be done upon exit.
+void freeFMMResources(void)
+{
+	free(Binomials);
+	free(SeriesFactors);
+	free(Multipoles);
+	free(Locals);
+	free(CellCounts);
+	free(LeafStarts);
+	free(Sorted);
+	free(BodyLeaves);
+	free(Translations);
+	free(TranslationScales);
+
+	Binomials = NULL;
+	SeriesFactors = NULL;
+	Multipoles = NULL;
+	Locals = NULL;
+	CellCounts = NULL;
+	LeafStarts = NULL;
+	Sorted = NULL;
+	BodyLeaves = NULL;
+	Translations = NULL;
+	TranslationScales = NULL;
+
+	CellsCapacity = 0;
+	TranslationLevels = 0;
+	LeavesCapacity = 0;
+	SortedCapacity = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef FMM_H
+#define FMM_H
+
+
+#include "bodies.h"
+
+
+// Fast multipole method (FMM): bodies are sorted in a uniform quadtree, whose cells gather their bodies gravity
+// in multipole expansions. Those are converted into local expansions at well separated cells, which are passed down
+// the tree. Neighbouring leaves interact directly. The cost is linear in the number of bodies, and the accuracy
+// is set by the order of the expansions. NULL states are skipped, accelerations are overwritten.
+void computeAccelerationsFMM(BodyState **states, int number);
+
+
+// Sets the order of the multipole expansions, FMM_ORDER by default.
+void setFMMOrder(int order);
+
+
+// Compares the FMM accelerations of the given bodies to the direct sum for several orders, and prints the relative
+// errors along the computation times, i.e. the error versus time curve.
+void validateFMM(Body **bodies, int bodies_number);
+
+
+// To be done upon exit.
+void freeFMMResources(void);
+
+
+#endif
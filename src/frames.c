@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "settings.h"
+#include "frames.h"
+#include "physics.h"
+
+
+// Massive bodies, which may be the parent of lighter ones, with the radius of their Hill sphere:
+typedef struct
+{
+	double Mass;
+	double HillRadius; // Infinite for root bodies.
+	int Index; // In the bodies array.
+} Candidate;
+
+
+// Local coordinates of a body, or their sum over several bodies:
+typedef struct
+{
+	double PosX;
+	double PosY;
+	double SpeedX;
+	double SpeedY;
+	double AccelX;
+	double AccelY;
+	double PrevPosX;
+	double PrevPosY;
+} Motion;
+
+
+static Candidate *Candidates = NULL;
+static double *AbsoluteX = NULL; // Absolute position of each body, for choosing parents.
+static double *AbsoluteY = NULL;
+static int Capacity = 0;
+
+static int StepsBeforeUpdate = 0;
+
+
+// Returns the body the position and speed of the given one are relative to, NULL if they are absolute.
+Body* getParent(Body *body)
+{
+	return FRAMES_ENABLED && body != NULL ? getBody(body -> Parent) : NULL;
+}
+
+
+// Returns the number of bodies from the given one to its root parent, both included. 0 for NULL.
+int getFrameDepth(Body *body)
+{
+	int depth = 0;
+
+	for (; body != NULL; body = getParent(body))
+		++depth;
+
+	return depth;
+}
+
+
+// Returns 1 if 'ancestor' is a parent of 'body', or a parent of its parents, 0 otherwise.
+int isAncestor(Body *ancestor, Body *body)
+{
+	for (Body *parent = getParent(body); parent != NULL; parent = getParent(parent))
+	{
+		if (parent == ancestor)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+// Absolute position of a body, its local one being summed with the ones of its parents:
+void getAbsolutePosition(Body *body, double *x, double *y)
+{
+	*x = body -> State -> PosX;
+	*y = body -> State -> PosY;
+
+	for (Body *parent = getParent(body); parent != NULL; parent = getParent(parent))
+	{
+		*x += parent -> State -> PosX;
+		*y += parent -> State -> PosY;
+	}
+}
+
+
+void getAbsoluteSpeed(Body *body, double *x, double *y)
+{
+	*x = body -> State -> SpeedX;
+	*y = body -> State -> SpeedY;
+
+	for (Body *parent = getParent(body); parent != NULL; parent = getParent(parent))
+	{
+		*x += parent -> State -> SpeedX;
+		*y += parent -> State -> SpeedY;
+	}
+}
+
+
+void getAbsoluteAcceleration(Body *body, double *x, double *y)
+{
+	*x = body -> State -> AccelX;
+	*y = body -> State -> AccelY;
+
+	for (Body *parent = getParent(body); parent != NULL; parent = getParent(parent))
+	{
+		*x += parent -> State -> AccelX;
+		*y += parent -> State -> AccelY;
+	}
+}
+
+
+static void addMotion(Motion *motion, Body *body)
+{
+	BodyState *state = body -> State;
+
+	motion -> PosX += state -> PosX;
+	motion -> PosY += state -> PosY;
+	motion -> SpeedX += state -> SpeedX;
+	motion -> SpeedY += state -> SpeedY;
+	motion -> AccelX += state -> AccelX;
+	motion -> AccelY += state -> AccelY;
+	motion -> PrevPosX += body -> PrevPosX;
+	motion -> PrevPosY += body -> PrevPosY;
+}
+
+
+// Motion of 'body' relative to 'reference', or absolute one if NULL. Local coordinates are only summed up to the
+// lowest common parent of both, for the result to keep its precision whatever their distance to the origin:
+static Motion relativeMotion(Body *body, Body *reference)
+{
+	Motion up = {0}, down = {0};
+
+	int body_depth = getFrameDepth(body), reference_depth = getFrameDepth(reference);
+
+	for (; body_depth > reference_depth; --body_depth, body = getParent(body))
+		addMotion(&up, body);
+
+	for (; reference_depth > body_depth; --reference_depth, reference = getParent(reference))
+		addMotion(&down, reference);
+
+	for (; body != reference; body = getParent(body), reference = getParent(reference))
+	{
+		addMotion(&up, body);
+		addMotion(&down, reference);
+	}
+
+	Motion motion = {up.PosX - down.PosX, up.PosY - down.PosY, up.SpeedX - down.SpeedX, up.SpeedY - down.SpeedY,
+		up.AccelX - down.AccelX, up.AccelY - down.AccelY, up.PrevPosX - down.PrevPosX, up.PrevPosY - down.PrevPosY};
+
+	return motion;
+}
+
+
+// Makes the coordinates of a body relative to 'parent', or absolute if NULL, without moving it. Its children follow it.
+// Accelerations are only converted if 'accelerations' is set, for they may be absolute ones while being computed.
+void setParent(Body *body, Body *parent, int accelerations)
+{
+	Motion motion = relativeMotion(body, parent);
+
+	BodyState *state = body -> State;
+
+	state -> PosX = motion.PosX;
+	state -> PosY = motion.PosY;
+	state -> SpeedX = motion.SpeedX;
+	state -> SpeedY = motion.SpeedY;
+
+	if (accelerations)
+	{
+		state -> AccelX = motion.AccelX;
+		state -> AccelY = motion.AccelY;
+	}
+
+	body -> PrevPosX = motion.PrevPosX;
+	body -> PrevPosY = motion.PrevPosY;
+
+	body -> Parent = getBodyHandle(parent);
+}
+
+
+static void reserveFrames(int bodies_number)
+{
+	if (bodies_number <= Capacity)
+		return;
+
+	freeFramesResources();
+
+	Candidates = (Candidate*) calloc(bodies_number, sizeof(Candidate));
+	AbsoluteX = (double*) calloc(bodies_number, sizeof(double));
+	AbsoluteY = (double*) calloc(bodies_number, sizeof(double));
+
+	if (Candidates == NULL || AbsoluteX == NULL || AbsoluteY == NULL)
+	{
+		printf("\nNot enough memory for the reference frames.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Capacity = bodies_number;
+}
+
+
+// By decreasing mass, then by index for the order not to depend on the sort implementation:
+static int compareMasses(const void *candidate1, const void *candidate2)
+{
+	const Candidate *c1 = (const Candidate*) candidate1, *c2 = (const Candidate*) candidate2;
+
+	if (c1 -> Mass != c2 -> Mass)
+		return c1 -> Mass > c2 -> Mass ? -1 : 1;
+
+	return c1 -> Index - c2 -> Index;
+}
+
+
+// By increasing Hill radius, then by index:
+static int compareHillRadii(const void *candidate1, const void *candidate2)
+{
+	const Candidate *c1 = (const Candidate*) candidate1, *c2 = (const Candidate*) candidate2;
+
+	if (c1 -> HillRadius != c2 -> HillRadius)
+		return c1 -> HillRadius < c2 -> HillRadius ? -1 : 1;
+
+	return c1 -> Index - c2 -> Index;
+}
+
+
+// Among the first 'number' candidates, the heavier one of smallest Hill sphere containing the body of given index.
+// Root bodies containing any other one, the first of them is taken if no other sphere does. -1 if none is heavier:
+static int findParent(int number, int index, double mass)
+{
+	int parent = -1;
+	double smallest = INFINITY;
+
+	for (int k = 0; k < number; ++k)
+	{
+		Candidate *candidate = Candidates + k;
+
+		double dx = AbsoluteX[candidate -> Index] - AbsoluteX[index];
+		double dy = AbsoluteY[candidate -> Index] - AbsoluteY[index];
+
+		int contained = dx * dx + dy * dy <= candidate -> HillRadius * candidate -> HillRadius;
+
+		if (candidate -> Mass > mass && contained && (parent == -1 || candidate -> HillRadius < smallest))
+		{
+			parent = candidate -> Index;
+			smallest = candidate -> HillRadius;
+		}
+	}
+
+	return parent;
+}
+
+
+// To be called before each physics step. Every REFERENCE_FRAMES_PERIOD steps, each body is made relative to the
+// heavier body of smallest Hill sphere containing it, if any, e.g. a moon to its planet, itself to its star.
+void updateReferenceFrames(Body **bodies, int bodies_number)
+{
+	if (!FRAMES_ENABLED || StepsBeforeUpdate-- > 0)
+		return;
+
+	StepsBeforeUpdate = REFERENCE_FRAMES_PERIOD - 1;
+
+	reserveFrames(bodies_number);
+
+	int candidates_number = 0;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		if (bodies[i] == NULL)
+			continue;
+
+		getAbsolutePosition(bodies[i], AbsoluteX + i, AbsoluteY + i);
+
+		if (!isTestParticle(bodies[i]))
+			Candidates[candidates_number++] = (Candidate) {bodies[i] -> Mass, INFINITY, i};
+	}
+
+	// Massive bodies by decreasing mass: parents are chosen, and their Hill spheres known, before their children's.
+	// Each body being only made relative to a heavier one whose frame is already updated, no cycle can appear:
+
+	qsort(Candidates, candidates_number, sizeof(Candidate), compareMasses);
+
+	for (int k = 0; k < candidates_number; ++k)
+	{
+		Candidate *candidate = Candidates + k;
+		Body *body = bodies[candidate -> Index];
+
+		int parent = findParent(k, candidate -> Index, candidate -> Mass);
+
+		if (parent != -1)
+		{
+			double dx = AbsoluteX[candidate -> Index] - AbsoluteX[parent];
+			double dy = AbsoluteY[candidate -> Index] - AbsoluteY[parent];
+
+			candidate -> HillRadius = sqrt(dx * dx + dy * dy) * cbrt(candidate -> Mass / (3. * bodies[parent] -> Mass));
+		}
+
+		Body *parent_body = parent == -1 ? NULL : bodies[parent];
+
+		if (getParent(body) != parent_body)
+			setParent(body, parent_body, 1);
+	}
+
+	// Test particles, the smallest Hill sphere containing them being the first one:
+
+	qsort(Candidates, candidates_number, sizeof(Candidate), compareHillRadii);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(THREAD_NUMBER) schedule(static)
+	#endif
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		Body *body = bodies[i];
+
+		if (body == NULL || !isTestParticle(body))
+			continue;
+
+		Body *parent_body = NULL;
+
+		for (int k = 0; k < candidates_number && parent_body == NULL; ++k)
+		{
+			double dx = AbsoluteX[Candidates[k].Index] - AbsoluteX[i];
+			double dy = AbsoluteY[Candidates[k].Index] - AbsoluteY[i];
+
+			if (dx * dx + dy * dy <= Candidates[k].HillRadius * Candidates[k].HillRadius)
+				parent_body = bodies[Candidates[k].Index];
+		}
+
+		if (getParent(body) != parent_body)
+			setParent(body, parent_body, 1);
+	}
+}
+
+
+// To be done upon exit.
+void freeFramesResources(void)
+{
+	free(Candidates);
+	free(AbsoluteX);
+	free(AbsoluteY);
+
+	Candidates = NULL;
+	AbsoluteX = NULL;
+	AbsoluteY = NULL;
+
+	Capacity = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+
+#include "bodies.h"
+
+
+// Reference frames are only used with the direct sum and the generic integrator, positions being absolute otherwise:
+#define FRAMES_ENABLED (REFERENCE_FRAMES && GRAVITY_SOLVER == 0 && INTEGRATOR == 0 && !EPHEMERIS_MODE)
+
+
+// Returns the body the position and speed of the given one are relative to, NULL if they are absolute.
+Body* getParent(Body *body);
+
+
+// Returns the number of bodies from the given one to its root parent, both included. 0 for NULL.
+int getFrameDepth(Body *body);
+
+
+// Returns 1 if 'ancestor' is a parent of 'body', or a parent of its parents, 0 otherwise.
+int isAncestor(Body *ancestor, Body *body);
+
+
+// Absolute position of a body, its local one being summed with the ones of its parents:
+void getAbsolutePosition(Body *body, double *x, double *y);
+
+
+void getAbsoluteSpeed(Body *body, double *x, double *y);
+
+
+void getAbsoluteAcceleration(Body *body, double *x, double *y);
+
+
+// Makes the coordinates of a body relative to 'parent', or absolute if NULL, without moving it. Its children follow it.
+// Accelerations are only converted if 'accelerations' is set, for they may be absolute ones while being computed.
+void setParent(Body *body, Body *parent, int accelerations);
+
+
+// To be called before each physics step. Every REFERENCE_FRAMES_PERIOD steps, each body is made relative to the
+// heavier body of smallest Hill sphere containing it, if any, e.g. a moon to its planet, itself to its star.
+void updateReferenceFrames(Body **bodies, int bodies_number);
+
+
+// To be done upon exit.
+void freeFramesResources(void);
+
+
+#endif
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "settings.h"
+#include "governor.h"
+#include "physics.h"
+#include "pacing.h"
+
+
+#define SMOOTHING 0.1 // Weight of the last frame in the costs moving averages.
+#define UPGRADE_MARGIN 0.8 // A better quality is only chosen if it fits in this fraction of the budget.
+
+
+// Simulation quality. Better qualities have lower values, in lexicographic order:
+typedef struct
+{
+	int RenderInterval; // A frame is rendered every 'RenderInterval' frames.
+	int ForceInterval;
+	int Substeps; // Higher is better, stored negated for comparison.
+} Quality;
+
+
+static Quality Current = {1, 1, -MAX_SUBSTEPS};
+
+static double ForceCost = 0.; // Mean time of a computation of the accelerations, in seconds.
+static double DrawCost = 0.; // Mean time of a rendered frame, in seconds.
+static double StepsPerFrame = 0.; // Mean number of physics steps per frame.
+
+static unsigned int FrameCounter = 0;
+
+
+static int compareQuality(Quality *q1, Quality *q2)
+{
+	if (q1 -> RenderInterval != q2 -> RenderInterval)
+		return q1 -> RenderInterval - q2 -> RenderInterval;
+
+	if (q1 -> ForceInterval != q2 -> ForceInterval)
+		return q1 -> ForceInterval - q2 -> ForceInterval;
+
+	return q1 -> Substeps - q2 -> Substeps;
+}
+
+
+static double movingAverage(double mean, double value)
+{
+	return mean == 0. ? value : (1. - SMOOTHING) * mean + SMOOTHING * value;
+}
+
+
+// Best quality fitting in the given time budget, degrading first the substeps number,
+// then reusing the accelerations, and finally skipping rendered frames:
+static Quality planQuality(double budget)
+{
+	Quality quality = {GOVERNOR_MAX_RENDER_INTERVAL, GOVERNOR_MAX_FORCE_INTERVAL, -GOVERNOR_MIN_SUBSTEPS}; // Worst.
+
+	for (int render_interval = 1; render_interval <= GOVERNOR_MAX_RENDER_INTERVAL; ++render_interval)
+	{
+		double physics_budget = budget - DrawCost / render_interval;
+
+		for (int force_interval = 1; force_interval <= GOVERNOR_MAX_FORCE_INTERVAL; ++force_interval)
+		{
+			double substeps = MIN(MAX_SUBSTEPS, physics_budget / (ForceCost * StepsPerFrame) * force_interval);
+
+			if (substeps >= GOVERNOR_MIN_SUBSTEPS)
+				return (Quality) {render_interval, force_interval, -(int) substeps};
+		}
+	}
+
+	return quality;
+}
+
+
+// Returns 1 if the current frame is to be rendered, 0 if rendering is skipped to save time.
+int governorShouldRender(void)
+{
+	return Current.RenderInterval == 1 || FrameCounter % Current.RenderInterval == 0;
+}
+
+
+// Gives the governor the time spent on the current frame, in seconds, and the number of physics steps done.
+// Every GOVERNOR_PERIOD frames, it picks the best simulation quality fitting in the frame time budget.
+void governorUpdate(double drawing_time, int rendered, double physics_time, int steps)
+{
+	if (!ENABLE_GOVERNOR || DETERMINISTIC)
+		return;
+
+	++FrameCounter;
+
+	int substeps = getSubsteps(), force_interval = getForceInterval();
+	int evaluations = (substeps + force_interval - 1) / force_interval;
+
+	StepsPerFrame = movingAverage(StepsPerFrame, steps);
+
+	if (steps > 0)
+		ForceCost = movingAverage(ForceCost, physics_time / (steps * evaluations));
+
+	if (rendered)
+		DrawCost = movingAverage(DrawCost, drawing_time);
+
+	if (FrameCounter % GOVERNOR_PERIOD != 0 || ForceCost == 0. || StepsPerFrame == 0.)
+		return;
+
+	double budget = GOVERNOR_BUDGET / getPacingFrameRate();
+
+	Quality quality = planQuality(budget);
+
+	// Upgrading only with some margin, for the quality not to oscillate:
+
+	if (compareQuality(&quality, &Current) < 0)
+	{
+		quality = planQuality(UPGRADE_MARGIN * budget);
+
+		if (compareQuality(&quality, &Current) >= 0)
+			return;
+	}
+
+	Current = quality;
+
+	setSubsteps(-Current.Substeps, Current.ForceInterval);
+}
+
+
+// Returns 1 if the simulation quality is currently lowered.
+int governorIsDegrading(void)
+{
+	return Current.RenderInterval > 1 || Current.ForceInterval > 1 || -Current.Substeps < getTargetSubsteps();
+}
+
+
+// Writes a short description of the current simulation quality.
+void getGovernorStatus(char *buffer, int size)
+{
+	if (!governorIsDegrading())
+		snprintf(buffer, size, "full");
+	else
+		snprintf(buffer, size, "lowered\n  %d substeps, forces/%d, drawn/%d",
+			getSubsteps(), Current.ForceInterval, Current.RenderInterval);
+}
@@ -0,0 +1,22 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+
+// Returns 1 if the current frame is to be rendered, 0 if rendering is skipped to save time.
+int governorShouldRender(void);
+
+
+// Gives the governor the time spent on the current frame, in seconds, and the number of physics steps done.
+// Every GOVERNOR_PERIOD frames, it picks the best simulation quality fitting in the frame time budget.
+void governorUpdate(double drawing_time, int rendered, double physics_time, int steps);
+
+
+// Returns 1 if the simulation quality is currently lowered.
+int governorIsDegrading(void);
+
+
+// Writes a short description of the current simulation quality.
+void getGovernorStatus(char *buffer, int size);
+
+
+#endif
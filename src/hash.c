@@ -0,0 +1,14 @@
+#include "hash.h"
+
+
+// Updates a FNV-1a hash with the given bytes:
+void hashBytes(uint64_t *hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char*) data;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		*hash ^= bytes[i];
+		*hash *= 1099511628211ULL;
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef HASH_H
+#define HASH_H
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define HASH_INIT 14695981039346656037ULL // Initial value of a hash.
+
+
+// Updates a FNV-1a hash with the given bytes:
+void hashBytes(uint64_t *hash, const void *data, size_t size);
+
+
+#endif
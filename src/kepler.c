@@ -0,0 +1,155 @@
+#include <math.h>
+
+#include "settings.h"
+#include "kepler.h"
+
+
+#define PI 3.14159265358979323846
+#define MAX_ITERATIONS 50
+#define TOLERANCE 1e-13 // Relative, on the universal anomaly.
+
+
+// Stumpff functions C(z) and S(z), with series close to 0 where the closed forms cancel out:
+static void stumpff(double z, double *c, double *s)
+{
+	if (fabs(z) < 1e-2)
+	{
+		*c = 1. / 2. - z * (1. / 24. - z * (1. / 720. - z * (1. / 40320. - z / 3628800.)));
+		*s = 1. / 6. - z * (1. / 120. - z * (1. / 5040. - z * (1. / 362880. - z / 39916800.)));
+	}
+
+	else if (z > 0.)
+	{
+		double root = sqrt(z);
+
+		*c = (1. - cos(root)) / z;
+		*s = (root - sin(root)) / (z * root);
+	}
+
+	else
+	{
+		double root = sqrt(-z);
+
+		*c = (cosh(root) - 1.) / -z;
+		*s = (sinh(root) - root) / (-z * root);
+	}
+}
+
+
+// Advances by 'dt' seconds a body in Keplerian motion around a fixed center of gravitational parameter 'mu',
+// position and speed being relative to that center. Universal variables are used, so that every kind of orbit
+// is handled: elliptic, parabolic and hyperbolic. Returns 0 on success, -1 if the solver didn't converge,
+// the body being then left untouched.
+int keplerDrift(double mu, double *x, double *y, double *vx, double *vy, double dt)
+{
+	double r0 = sqrt(*x * *x + *y * *y);
+	double speed_squared = *vx * *vx + *vy * *vy;
+
+	if (r0 == 0. || mu <= 0. || dt == 0.)
+		return -1;
+
+	double sqrt_mu = sqrt(mu);
+	double radial = (*x * *vx + *y * *vy) / sqrt_mu; // r0 . v0 / sqrt(mu)
+	double alpha = 2. / r0 - speed_squared / mu; // Inverse of the semi-major axis.
+
+	// Whole periods don't change anything on closed orbits:
+
+	if (alpha > 0.)
+	{
+		double period = 2. * PI / (sqrt_mu * alpha * sqrt(alpha));
+
+		dt = fmod(dt, period);
+	}
+
+	// Kepler equation in the universal anomaly chi, F(chi) = 0, solved with Laguerre's method, which converges
+	// from poor initial guesses:
+
+	double chi = sqrt_mu * dt / r0;
+
+	if (alpha > 0.)
+		chi = sqrt_mu * alpha * dt;
+
+	else if (alpha < 0.) // Hyperbolic orbit, Vallado's guess:
+	{
+		double a = 1. / alpha, sign = dt > 0. ? 1. : -1.;
+		double ratio = -2. * mu * alpha * dt / (radial * sqrt_mu + sign * sqrt(-mu * a) * (1. - r0 * alpha));
+
+		if (ratio > 0.)
+			chi = sign * sqrt(-a) * log(ratio);
+	}
+	double c, s, z;
+
+	int iteration = 0;
+
+	for (; iteration < MAX_ITERATIONS; ++iteration)
+	{
+		z = alpha * chi * chi;
+		stumpff(z, &c, &s);
+
+		double chi_squared = chi * chi;
+
+		double f = radial * chi_squared * c + (1. - alpha * r0) * chi_squared * chi * s + r0 * chi - sqrt_mu * dt;
+		double df = radial * chi * (1. - z * s) + (1. - alpha * r0) * chi_squared * c + r0; // The radius.
+		double ddf = radial * (1. - z * c) + (1. - alpha * r0) * chi * (1. - z * s);
+
+		const double n = 5.;
+
+		double root = sqrt(fabs((n - 1.) * (n - 1.) * df * df - n * (n - 1.) * f * ddf));
+		double delta = n * f / (df + (df >= 0. ? root : -root));
+
+		chi -= delta;
+
+		if (fabs(delta) <= TOLERANCE * MAX(fabs(chi), 1e-300))
+			break;
+	}
+
+	if (iteration == MAX_ITERATIONS || !isfinite(chi))
+		return -1;
+
+	z = alpha * chi * chi;
+	stumpff(z, &c, &s);
+
+	// Lagrange coefficients:
+
+	double chi_squared = chi * chi;
+
+	double f = 1. - chi_squared / r0 * c;
+	double g = dt - chi_squared * chi * s / sqrt_mu;
+
+	double new_x = f * *x + g * *vx;
+	double new_y = f * *y + g * *vy;
+
+	double r = sqrt(new_x * new_x + new_y * new_y);
+
+	double df = sqrt_mu / (r * r0) * (z * chi * s - chi);
+	double dg = 1. - chi_squared / r * c;
+
+	double new_vx = df * *x + dg * *vx;
+	double new_vy = df * *y + dg * *vy;
+
+	*x = new_x;
+	*y = new_y;
+	*vx = new_vx;
+	*vy = new_vy;
+
+	return 0;
+}
+
+
+// Periapsis distance of a body in Keplerian motion around a center of gravitational parameter 'mu', position
+// and speed being relative to that center. 0 for radial orbits.
+double keplerPeriapsis(double mu, double x, double y, double vx, double vy)
+{
+	double r = sqrt(x * x + y * y);
+	double radial = x * vx + y * vy;
+	double energy_term = vx * vx + vy * vy - mu / r;
+
+	// Eccentricity vector, times mu:
+
+	double ex = energy_term * x - radial * vx;
+	double ey = energy_term * y - radial * vy;
+
+	double h = x * vy - y * vx; // Specific angular momentum.
+
+	return h * h / (mu + sqrt(ex * ex + ey * ey));
+}
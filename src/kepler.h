@@ -0,0 +1,17 @@
+#ifndef KEPLER_H
+#define KEPLER_H
+
+
+// Advances by 'dt' seconds a body in Keplerian motion around a fixed center of gravitational parameter 'mu',
+// position and speed being relative to that center. Universal variables are used, so that every kind of orbit
+// is handled: elliptic, parabolic and hyperbolic. Returns 0 on success, -1 if the solver didn't converge,
+// the body being then left untouched.
+int keplerDrift(double mu, double *x, double *y, double *vx, double *vy, double dt);
+
+
+// Periapsis distance of a body in Keplerian motion around a center of gravitational parameter 'mu', position
+// and speed being relative to that center. 0 for radial orbits.
+double keplerPeriapsis(double mu, double x, double y, double vx, double vy);
+
+
+#endif
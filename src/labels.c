@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "settings.h"
+#include "labels.h"
+
+
+#define SLOT_NUMBER (LABEL_ATLAS_COLUMNS * LABEL_ATLAS_ROWS)
+
+#define GRID_WIDTH ((WINDOW_WIDTH + LABEL_CELL_SIZE - 1) / LABEL_CELL_SIZE)
+#define GRID_HEIGHT ((WINDOW_HEIGHT + LABEL_CELL_SIZE - 1) / LABEL_CELL_SIZE)
+
+
+typedef struct
+{
+	BodyHandle Owner; // NoBody if the slot is free. Bodies may move, hence the handle.
+	int Width; // Width of the rendered name.
+	unsigned int LastUsedFrame;
+} LabelSlot;
+
+
+// Created on the first drawn label:
+static SDL_Texture *Atlas = NULL;
+static int SlotHeight;
+
+static LabelSlot Slots[SLOT_NUMBER];
+
+static unsigned int LabelsFrame = 0;
+static int NewLabelsNumber = 0; // Number of names rendered during this frame.
+
+// Cells of the window covered by the labels drawn during this frame:
+static unsigned char Occupied[GRID_HEIGHT][GRID_WIDTH];
+
+
+static void initAtlas(void)
+{
+	SlotHeight = TTF_FontHeight(font_small);
+
+	Atlas = SDLA_CreateBlankTexture(LABEL_ATLAS_COLUMNS * LABEL_SLOT_WIDTH, LABEL_ATLAS_ROWS * SlotHeight);
+
+	for (int i = 0; i < SLOT_NUMBER; ++i)
+		Slots[i].Owner = NoBody;
+}
+
+
+static SDL_Rect slotRect(int slot)
+{
+	SDL_Rect rect = {(slot % LABEL_ATLAS_COLUMNS) * LABEL_SLOT_WIDTH, (slot / LABEL_ATLAS_COLUMNS) * SlotHeight,
+		LABEL_SLOT_WIDTH, SlotHeight};
+
+	return rect;
+}
+
+
+// Returns a free slot, or else the least recently used one. Slots used during
+// this frame are never evicted, -1 is returned if all of them are.
+static int findSlot(void)
+{
+	int best = -1;
+
+	for (int i = 0; i < SLOT_NUMBER; ++i)
+	{
+		if (getBody(Slots[i].Owner) == NULL)
+			return i;
+
+		if (Slots[i].LastUsedFrame != LabelsFrame && (best == -1 || Slots[i].LastUsedFrame < Slots[best].LastUsedFrame))
+			best = i;
+	}
+
+	return best;
+}
+
+
+// Range of cells covered by the given on-screen rectangle, clipped to the window.
+// Returns 0 if the rectangle is out of the window:
+static int cellRange(int x, int y, int w, int h, int *xmin, int *xmax, int *ymin, int *ymax)
+{
+	if (x + w <= LEFT_MARGIN || x >= WINDOW_WIDTH || y + h <= 0 || y >= WINDOW_HEIGHT)
+		return 0;
+
+	*xmin = MAX(x, 0) / LABEL_CELL_SIZE;
+	*xmax = MIN(x + w - 1, WINDOW_WIDTH - 1) / LABEL_CELL_SIZE;
+	*ymin = MAX(y, 0) / LABEL_CELL_SIZE;
+	*ymax = MIN(y + h - 1, WINDOW_HEIGHT - 1) / LABEL_CELL_SIZE;
+
+	return 1;
+}
+
+
+static int isOccupied(int xmin, int xmax, int ymin, int ymax)
+{
+	for (int j = ymin; j <= ymax; ++j)
+	{
+		for (int i = xmin; i <= xmax; ++i)
+		{
+			if (Occupied[j][i])
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+static void occupy(int xmin, int xmax, int ymin, int ymax)
+{
+	for (int j = ymin; j <= ymax; ++j)
+		memset(Occupied[j] + xmin, 1, xmax - xmin + 1);
+}
+
+
+// To be called once per frame, before drawing any label. Forgets the labels drawn at the last frame.
+void beginLabelsFrame(void)
+{
+	memset(Occupied, 0, sizeof(Occupied));
+
+	++LabelsFrame;
+	NewLabelsNumber = 0;
+}
+
+
+// Draws the name of the body, horizontally centered on 'x' and starting at 'y'. The name is rendered
+// in the atlas if not already there. Nothing is drawn if it would overlap an already drawn label.
+void drawLabel(Body *body, int x, int y)
+{
+	if (body == NULL || body -> Name[0] == '\0')
+		return;
+
+	if (Atlas == NULL)
+		initAtlas();
+
+	int slot = body -> LabelSlot;
+	int cached = slot >= 0 && getBody(Slots[slot].Owner) == body;
+
+	int xmin, xmax, ymin, ymax;
+
+	// Cheap check on the label center, before measuring or rendering anything:
+	if (!cellRange(x, y, 1, SlotHeight, &xmin, &xmax, &ymin, &ymax) || isOccupied(xmin, xmax, ymin, ymax))
+		return;
+
+	int width = cached ? Slots[slot].Width : MIN(SDLA_TextSize(font_small, body -> Name), LABEL_SLOT_WIDTH);
+
+	x -= width / 2;
+
+	if (!cellRange(x, y, width, SlotHeight, &xmin, &xmax, &ymin, &ymax) || isOccupied(xmin, xmax, ymin, ymax))
+		return;
+
+	if (!cached)
+	{
+		if (NewLabelsNumber >= LABEL_NEW_PER_FRAME || (slot = findSlot()) == -1)
+			return; // Will be done during a next frame.
+
+		Body *owner = getBody(Slots[slot].Owner);
+
+		if (owner != NULL)
+			owner -> LabelSlot = -1; // Evicted.
+
+		SDL_Rect rect = slotRect(slot);
+
+		Slots[slot].Owner = getBodyHandle(body);
+		Slots[slot].Width = SDLA_UpdateTextTexture(Atlas, &rect, font_small, &White, body -> Name);
+
+		body -> LabelSlot = slot;
+
+		++NewLabelsNumber;
+	}
+
+	Slots[slot].LastUsedFrame = LabelsFrame;
+
+	occupy(xmin, xmax, ymin, ymax);
+
+	SDL_Rect src = slotRect(slot);
+	src.w = Slots[slot].Width;
+
+	SDL_Rect dst = {x, y, src.w, src.h};
+
+	if (SDL_RenderCopy(renderer, Atlas, &src, &dst) != 0)
+		SDLA_ExitWithError("Impossible to draw a label.");
+}
+
+
+// Frees the atlas slot used by the body, if any. Done when freeing a body.
+void releaseLabel(Body *body)
+{
+	if (body == NULL || body -> LabelSlot < 0)
+		return;
+
+	if (getBody(Slots[body -> LabelSlot].Owner) == body)
+		Slots[body -> LabelSlot].Owner = NoBody;
+
+	body -> LabelSlot = -1;
+}
+
+
+// To be done upon exit.
+void freeLabels(void)
+{
+	SDL_DestroyTexture(Atlas);
+	Atlas = NULL;
+
+	memset(Slots, 0, sizeof(Slots));
+}
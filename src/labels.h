@@ -0,0 +1,31 @@
+#ifndef LABELS_H
+#define LABELS_H
+
+
+#include "bodies.h"
+
+
+extern SDL_Renderer *renderer;
+
+extern TTF_Font *font_small;
+extern SDL_Color White;
+
+
+// To be called once per frame, before drawing any label. Forgets the labels drawn at the last frame.
+void beginLabelsFrame(void);
+
+
+// Draws the name of the body, horizontally centered on 'x' and starting at 'y'. The name is rendered
+// in the atlas if not already there. Nothing is drawn if it would overlap an already drawn label.
+void drawLabel(Body *body, int x, int y);
+
+
+// Frees the atlas slot used by the body, if any. Done when freeing a body.
+void releaseLabel(Body *body);
+
+
+// To be done upon exit.
+void freeLabels(void);
+
+
+#endif
@@ -9,13 +9,22 @@
 #include "physics.h"
 #include "user_inputs.h"
 #include "simulations.h"
+#include "trails.h"
+#include "pacing.h"
+#include "governor.h"
+#include "turbo.h"
+#include "reorder.h"
+#include "pm.h"
+#include "fmm.h"
+#include "symplectic.h"
+#include "ephemeris.h"
+#include "determinism.h"
+#include "frames.h"
 
 
 ////////////////////////////////////////////////////////////
 // Global variables:
 
-extern const int FrameTime;
-
 SDL_Window *window;
 SDL_Renderer *renderer;
 
@@ -38,8 +47,9 @@ int Quit = 0;
 int RenderScene = 1;
 int SimulationRunning = 1;
 int CameraFollowing = 0;
-int IndexFollowedBody = 0;
+BodyHandle FollowedBody = {-1, 0};
 int DrawAllNames = 1;
+int DrawTrails = 0;
 int CollisionsEnabled = 1;
 
 unsigned int SimulationFrameIndex = 0; // For controlling the simulation elapsed time.
@@ -49,7 +59,7 @@ double FrameBatchTime = 0.; // Used to store the sum of the real frame times, pe
 
 int main(int argc, char **argv)
 {
-	srand(time(NULL)); // Initializing randomness.
+	srand(DETERMINISTIC ? DETERMINISTIC_SEED : time(NULL)); // Initializing randomness.
 
 	////////////////////////////////////////////////////////////
 	// Initializing SDLA - rendering:
@@ -97,7 +107,7 @@ int main(int argc, char **argv)
 		bodies = simul_3Earths(&bodies_number, &ship);
 	}
 
-	else
+	else if (atoi(argv[1]) == 2)
 	{
 		// Many Earth-like planets:
 		bodies = simul_manyBodies(&bodies_number, &ship);
@@ -105,6 +115,46 @@ int main(int argc, char **argv)
 		DrawAllNames = 0; // More satisfying that way.
 	}
 
+	else if (atoi(argv[1]) == 3)
+	{
+		// A star and its disk:
+		bodies = simul_disk(&bodies_number, &ship);
+
+		DrawAllNames = 0;
+	}
+
+	else
+	{
+		// A star, its planets and a ring of test particles:
+		bodies = simul_ring(&bodies_number, &ship);
+
+		DrawAllNames = 0;
+	}
+
+	FollowedBody = getBodyHandle(bodies[0]);
+
+	// The ship may be absorbed, hence it is only referenced by handle:
+	BodyHandle ship_handle = getBodyHandle(ship);
+
+	// Checking the approximate solvers accuracy, the direct sum being too slow for many bodies:
+
+	if (SOLVER_VALIDATION && bodies_number <= SOLVER_VALIDATION_MAX_BODIES)
+	{
+		if (GRAVITY_SOLVER == 1)
+			validatePM(bodies, bodies_number);
+
+		else if (GRAVITY_SOLVER == 2)
+			validateFMM(bodies, bodies_number);
+	}
+
+	if (SOLVER_VALIDATION && MIXED_PRECISION)
+		validateMixedPrecision(bodies, bodies_number);
+
+	// Optional second argument: a number of simulated years to fast-forward to.
+
+	if (argc > 2 && atof(argv[2]) > 0.)
+		setTurboTarget(atof(argv[2]) * 365.25 * 24. * 3600.);
+
 	////////////////////////////////////////////////////////////
 	// Benchmarking 'UPDATES_BY_FRAME':
 
@@ -113,7 +163,44 @@ int main(int argc, char **argv)
 	////////////////////////////////////////////////////////////
 	// Main loop:
 
-	Uint32 lastTime = SDL_GetTicks();
+	// Frames are paced either by the display refresh rate, or by FRAMERATE:
+
+	int refresh_rate = USE_VSYNC && SDLA_SetVSync(1) == 0 ? SDLA_GetRefreshRate() : 0;
+
+	if (refresh_rate > 0)
+	{
+		printf("Vsync enabled, refresh rate: %d Hz\n\n", refresh_rate);
+
+		initPacing(refresh_rate, 1);
+	}
+
+	else
+	{
+		if (USE_VSYNC)
+			SDLA_SetVSync(0);
+
+		initPacing(FRAMERATE, 0);
+	}
+
+	// Physics steps are either done at their own rate, drawing being interpolated, or once per frame.
+	// In both cases, the time scale is kept. In deterministic mode, the physics rate doesn't depend on the display:
+
+	double steps_per_frame = 1.; // Mean number of physics steps per displayed frame.
+	double step_accumulator = 0.;
+
+	if (DRAWING_INTERPOLATION || DETERMINISTIC)
+	{
+		setFrameRate(PHYSICS_RATE);
+		steps_per_frame = PHYSICS_RATE / getPacingFrameRate();
+	}
+
+	else
+		setFrameRate(getPacingFrameRate());
+
+	// The ephemeris depends on the physics time step:
+
+	if (EPHEMERIS_MODE)
+		initEphemeris(bodies, bodies_number);
 
 	// For controlling the rendering:
 	// unsigned int renderFrameIndex = 0;
@@ -122,6 +209,7 @@ int main(int argc, char **argv)
 
 	double frameStartTime, start, end;
 	double drawingTime = 0., simulationTime = 0.;
+	unsigned int simulatedFrames = 0; // Frames during which the simulation ran, for the benchmark means.
 
 	while (!Quit)
 	{
@@ -130,23 +218,30 @@ int main(int argc, char **argv)
 		////////////////////////////////////////////////////////////
 		// Input control:
 
-		input_control(&current_input, bodies_number);
+		// When paused with nothing to redraw, blocking until an event comes instead of waking up every frame:
+
+		int idle = !SimulationRunning && !RenderScene && !isInputHeld();
+
+		input_control(&current_input, bodies, bodies_number, idle ? INPUT_IDLE_TIMEOUT : 0);
 
 		////////////////////////////////////////////////////////////
 		// Drawing:
 
 		start = realTime();
 
-		if (SimulationRunning)
+		// Some frames may not be rendered when the governor lowers the quality:
+		if (SimulationRunning && governorShouldRender())
 			RenderScene = 1;
 
+		int presented = RenderScene;
+
 		if (RenderScene)
 		{
 			SDLA_ClearWindow(NULL);
 
 			// This has to be done before drawing bodies:
 			if (CameraFollowing)
-				followBody(bodies[IndexFollowedBody]);
+				followBody(getBody(FollowedBody));
 
 			drawBodies(bodies, bodies_number, &current_input);
 
@@ -156,6 +251,8 @@ int main(int argc, char **argv)
 			// Rendering:
 			SDL_RenderPresent(renderer);
 
+			inputPresented();
+
 			RenderScene = 0;
 
 			// ++renderFrameIndex;
@@ -163,60 +260,112 @@ int main(int argc, char **argv)
 		}
 
 		end = realTime();
-		drawingTime += SimulationRunning ? end - start : 0.;
+		double frameDrawingTime = end - start;
+		drawingTime += SimulationRunning ? frameDrawingTime : 0.;
 		start = end;
 
 		////////////////////////////////////////////////////////////
 		// Bodies and ship movement:
 
-		if (SimulationRunning) // Don't move things when paused!
+		int steps = 0;
+		int turbo = isTurboOn();
+
+		if (SimulationRunning && turbo)
 		{
 			double thrust = 5.;
 
-			moveBodies(bodies, bodies_number, ship, &current_input, thrust);
+			// Physics steps back-to-back, until the next drawing:
+			steps = runTurbo(bodies, bodies_number, ship_handle, &current_input, thrust);
 
-			++SimulationFrameIndex;
+			RenderScene = 1;
 		}
 
-		simulationTime += SimulationRunning ? realTime() - start : 0.;
+		else if (SimulationRunning) // Don't move things when paused!
+		{
+			double thrust = 5.;
 
-		// Removing absorbed bodies, both for performance improvement and for a correct following of bodies:
-		refreshBodyArray(&bodies, &bodies_number);
+			step_accumulator += steps_per_frame;
+			steps = (int) step_accumulator;
+			step_accumulator -= steps;
 
-		////////////////////////////////////////////////////////////
-		// Refresh rate control:
+			steps = MIN(steps, MAX_STEPS_PER_FRAME);
 
-		// Don't use an unsigned integer! Will wait an eternity if it overflows...
-		int time_passed = SDL_GetTicks() - lastTime;
+			// The ship is looked up before each step, for it may have been absorbed by the previous one:
 
-		int to_wait = MAX(0, FrameTime - time_passed);
+			for (int s = 0; s < steps; ++s)
+			{
+				moveBodies(bodies, bodies_number, getBody(ship_handle), &current_input, thrust);
 
-		// printf("to_wait = %d\n", to_wait); // in SDL ticks. Must be > 0 in order to work well.
+				++SimulationFrameIndex;
 
-		SDL_Delay(to_wait); // In menus: 0% CPU usage.
+				checkDeterminism(bodies, bodies_number);
 
-		lastTime = SDL_GetTicks();
+				sampleTrails(bodies, bodies_number);
+			}
+
+			// The next frame is drawn this far between the two last physics states:
+			setDrawingInterpolation(step_accumulator);
+		}
+
+		if (SimulationRunning)
+		{
+			double framePhysicsTime = realTime() - start;
+
+			simulationTime += framePhysicsTime;
+			++simulatedFrames;
+
+			// Frame times are meaningless for the governor when fast-forwarding:
+			if (!turbo)
+				governorUpdate(frameDrawingTime, presented, framePhysicsTime, steps);
+		}
+
+		// Removing absorbed bodies, both for performance improvement and for a correct following of bodies:
+		int previous_bodies_number = bodies_number;
+
+		refreshBodyArray(bodies, &bodies_number);
+
+		// Keeping bodies close in space close in memory:
+		updateBodiesOrder(bodies, bodies_number, bodies_number != previous_bodies_number);
+
+		////////////////////////////////////////////////////////////
+		// Refresh rate control:
+
+		// No waiting when fast-forwarding, nor after having waited for an input:
+
+		if (!idle && (!turbo || !SimulationRunning))
+			waitNextFrame(presented);
 
 		end = realTime();
 
 		FrameBatchTime += SimulationRunning ? end - frameStartTime : 0.;
 	}
 
-	if (BENCHMARK_SIMULATION && SimulationFrameIndex != 0)
+	if (BENCHMARK_SIMULATION && simulatedFrames != 0)
 	{
-		printf("\nDrawing mean: %.2f ms\n", 1000. * drawingTime / SimulationFrameIndex);
-		printf("Physics mean time: %.2f ms\n", 1000. * simulationTime / SimulationFrameIndex);
+		printf("\nDrawing mean: %.2f ms\n", 1000. * drawingTime / simulatedFrames);
+		printf("Physics mean time: %.2f ms\n", 1000. * simulationTime / simulatedFrames);
+
+		printInputLatency();
 	}
 
 	////////////////////////////////////////////////////////////
 	// Freeing and Quitting:
 
 	freePhysicsResources();
+	freeDrawingResources();
+	freeTrails();
+	freeReorderResources();
+	freePMResources();
+	freeFMMResources();
+	freeSymplecticResources();
+	freeEphemerisResources();
+	freeFramesResources();
 
 	for (int i = 0; i < bodies_number; ++i)
 		freeBody(bodies[i]);
 
 	free(bodies);
+	freeBodyArena();
 
 	SDLA_FreeCachedFont(cached_font_medium);
 
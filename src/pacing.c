@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "settings.h"
+#include "pacing.h"
+#include "simulations.h"
+
+
+static Uint64 FramePeriod = 0; // In ns.
+static Uint64 Remainder = 0; // Fraction of ns per frame, in units of 1 / FrameRate ns.
+static double FrameRate = FRAMERATE;
+static int Vsync = 0;
+
+static Uint64 Deadline = 0; // In ns.
+static Uint64 RemainderSum = 0;
+
+
+// Starts pacing frames at the given rate. If 'vsync' is set, frames are expected to be paced by
+// SDL_RenderPresent(), and 'framerate' must be the display refresh rate.
+void initPacing(double framerate, int vsync)
+{
+	FrameRate = framerate;
+	Vsync = vsync;
+
+	// The period is split in an integer number of ns, plus a remainder which is accumulated
+	// over frames. Integer rates such as FRAMERATE are therefore kept exactly on average:
+
+	Uint64 rate = framerate;
+
+	if (rate == framerate && rate > 0)
+	{
+		FramePeriod = 1000000000ull / rate;
+		Remainder = 1000000000ull % rate;
+	}
+
+	else
+	{
+		FramePeriod = 1e9 / framerate;
+		Remainder = 0;
+	}
+
+	Deadline = realTimeNs() + FramePeriod;
+	RemainderSum = 0;
+}
+
+
+static void setNextDeadline(Uint64 now)
+{
+	Deadline += FramePeriod;
+	RemainderSum += Remainder;
+
+	Uint64 rate = FrameRate;
+
+	if (Remainder != 0 && RemainderSum >= rate)
+	{
+		++Deadline;
+		RemainderSum -= rate;
+	}
+
+	// Too late by more than a frame, e.g. after a slow frame: restarting from now,
+	// instead of rushing several frames to catch up:
+
+	if (now > Deadline + FramePeriod)
+	{
+		Deadline = now + FramePeriod;
+		RemainderSum = 0;
+	}
+}
+
+
+// Waits until the deadline of the current frame, then sets the next one. 'presented' tells if the frame
+// has been presented, which with vsync already did the waiting. Deadlines are absolute, hence rounding
+// errors do not accumulate, and the average frame rate is exact as long as frames are on time.
+void waitNextFrame(int presented)
+{
+	Uint64 now = realTimeNs();
+
+	if (Vsync && presented)
+	{
+		Deadline = now;
+		setNextDeadline(now);
+		return;
+	}
+
+	// Sleeping most of the remaining time, 0% CPU usage:
+
+	const Uint64 spin_time = PACING_SPIN_TIME * 1e9;
+
+	if (now + spin_time < Deadline)
+	{
+		SDL_Delay((Deadline - now - spin_time) / 1000000);
+		now = realTimeNs();
+	}
+
+	// Then busy-waiting, for precision:
+
+	while (now < Deadline)
+		now = realTimeNs();
+
+	setNextDeadline(now);
+}
+
+
+// Returns the frame rate used for pacing.
+double getPacingFrameRate(void)
+{
+	return FrameRate;
+}
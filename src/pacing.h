@@ -0,0 +1,23 @@
+#ifndef PACING_H
+#define PACING_H
+
+
+#include "SDLA.h"
+
+
+// Starts pacing frames at the given rate. If 'vsync' is set, frames are expected to be paced by
+// SDL_RenderPresent(), and 'framerate' must be the display refresh rate.
+void initPacing(double framerate, int vsync);
+
+
+// Waits until the deadline of the current frame, then sets the next one. 'presented' tells if the frame
+// has been presented, which with vsync already did the waiting. Deadlines are absolute, hence rounding
+// errors do not accumulate, and the average frame rate is exact as long as frames are on time.
+void waitNextFrame(int presented);
+
+
+// Returns the frame rate used for pacing.
+double getPacingFrameRate(void);
+
+
+#endif
@@ -1,40 +1,178 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "physics.h"
+#include "pm.h"
+#include "fmm.h"
+#include "symplectic.h"
+#include "ephemeris.h"
+#include "simulations.h"
+#include "frames.h"
+#include "kepler.h"
 
 
-#define FRAMETIME (1000 / FRAMERATE) // integer
-#define REAL_FRAMERATE (1000. / FRAMETIME) // double, != FRAMERATE
-#define DELTA_TIME ((double) INIT_TIME_MULTIPLIER / (REAL_FRAMERATE * UPDATES_PER_FRAME)) // Do not modify.
+#define DELTA_TIME ((double) INIT_TIME_MULTIPLIER / (FRAMERATE * UPDATES_PER_FRAME)) // Do not modify.
 
+#define ADAPTIVE_SAFETY 0.9 // The error estimate is aimed at this fraction of ADAPTIVE_TOLERANCE.
+#define ADAPTIVE_MIN_FACTOR 0.5 // Bounds of the change of the number of substeps from one frame to the next.
+#define ADAPTIVE_MAX_FACTOR 2.
+
+#define SMALL_SYSTEM_MAX_BODIES 8 // Bodies numbers up to which specialized kernels are instantiated. Do not modify.
+
+// Copies a function in each of its callers, for its loops of constant bounds there to be unrolled:
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+// Kepler fast-forward is only used with the direct sum and the generic integrator:
+#define KEPLER_ENABLED (KEPLER_FAST_FORWARD && GRAVITY_SOLVER == 0 && INTEGRATOR == 0 && !EPHEMERIS_MODE)
 
-const double GravitationalConst = 6.67430e-11; // m3 / (kg . s2)
 
-const int FrameTime = FRAMETIME; // In ms. Integer!
+const double GravitationalConst = 6.67430e-11; // m3 / (kg . s2)
 
 // This can be changed during runtime:
 static double dt = DELTA_TIME; // Time interval.
-static double dt2s2 = DELTA_TIME * DELTA_TIME / (2 - CHEAT); // dt * dt / 2 if CHEAT = 0, dt * dt else.
-static double FrameTimeMultiplier = (double) INIT_TIME_MULTIPLIER / REAL_FRAMERATE;
+static double FrameRate = FRAMERATE; // Actual frames per second, see setFrameRate().
+static double FrameTimeMultiplier = (double) INIT_TIME_MULTIPLIER / FRAMERATE;
+static int Substeps = UPDATES_PER_FRAME; // Lowest of the two following values.
+static int TargetSubsteps = UPDATES_PER_FRAME; // Needed for accuracy, chosen by adaptSubsteps().
+static int SubstepsLimit = MAX_SUBSTEPS; // Lowered by the governor when frames are late.
+static double StepError = 0.; // Largest error estimate of the last physics step, see stepErrorSquared().
+static int ForceInterval = 1; // Accelerations are only computed every 'ForceInterval' substeps.
 static double ElapsedSimulationTime = 0.;
 static unsigned int LastSimulationFrameIndex = 0;
 
 static double *DistArray = NULL; // Used as a buffer for physics coomputations. To be freed at exit.
+static int DistCapacity = 0;
+
+// Hot part of each body, massive bodies first then test particles, each in the bodies array order. To be freed at exit.
+static BodyState **States = NULL;
+static int *StateIndexes = NULL; // Index of each state body in the bodies array.
+static int StatesNumber = 0;
+static int MassiveNumber = 0;
+static int IntegratedNumber = 0; // Test particles past that one are moved along their Kepler orbit instead.
+static int StatesCapacity = 0;
+
+// Massive bodies as seen by the test particles kernel, as a structure of arrays:
+static double *SourcesX = NULL, *SourcesY = NULL, *SourcesGravity = NULL, *SourcesRadius = NULL;
+static int *SourceStates = NULL; // Index in States.
+static int *Hits = NULL; // For each state, the one of a massive body it overlaps, -1 if none.
+static double *PrevAccelX = NULL, *PrevAccelY = NULL; // Accelerations before their last computation.
+static double *SourcesSpeedX = NULL, *SourcesSpeedY = NULL, *SourcesSpeed = NULL;
+static int *Contacted = NULL; // For each massive state, 1 if it has merged during the current computation.
+
+// With REFERENCE_FRAMES, index in States of the parent of each state, -1 for absolute ones, and the absolute
+// positions, speeds and accelerations of the massive bodies, i.e. of the origins of the frames:
+static int *ParentStates = NULL;
+static double *FrameX = NULL, *FrameY = NULL, *FrameSpeedX = NULL, *FrameSpeedY = NULL;
+static double *FrameAccelX = NULL, *FrameAccelY = NULL;
+
+// With KEPLER_FAST_FORWARD, the absolute accelerations of the sources, the attractor of each test particle as
+// an index in States, -1 if it is to be integrated, and for the ones moved along their Kepler orbit, listed from
+// IntegratedNumber on, their attractor and their position and speed relative to it at the start of the step:
+static double *SourcesAccelX = NULL, *SourcesAccelY = NULL;
+static int *Attractors = NULL;
+static BodyState **KeplerStates = NULL; // Used while moving those states after the integrated ones.
+static int *KeplerIndexes = NULL, *KeplerParents = NULL;
+static int *KeplerAttractors = NULL;
+static double *KeplerX = NULL, *KeplerY = NULL, *KeplerSpeedX = NULL, *KeplerSpeedY = NULL;
+
+// Massive bodies which come into contact before the next computation of the accelerations:
+typedef struct
+{
+	double Time; // From now.
+	int First; // Indexes in States.
+	int Second;
+} Contact;
+
+static Contact *Contacts = NULL;
+static int ContactsNumber = 0;
+static int ContactsCapacity = 0;
 
 
 void freePhysicsResources(void)
 {
 	free(DistArray);
 	DistArray = NULL;
+	DistCapacity = 0;
+
+	free(States);
+	free(StateIndexes);
+	free(SourcesX);
+	free(SourcesY);
+	free(SourcesGravity);
+	free(SourcesRadius);
+	free(SourceStates);
+	free(Hits);
+	free(PrevAccelX);
+	free(PrevAccelY);
+	free(SourcesSpeedX);
+	free(SourcesSpeedY);
+	free(SourcesSpeed);
+	free(Contacted);
+	free(Contacts);
+	free(ParentStates);
+	free(FrameX);
+	free(FrameY);
+	free(FrameSpeedX);
+	free(FrameSpeedY);
+	free(FrameAccelX);
+	free(FrameAccelY);
+	free(SourcesAccelX);
+	free(SourcesAccelY);
+	free(Attractors);
+	free(KeplerStates);
+	free(KeplerIndexes);
+	free(KeplerParents);
+	free(KeplerAttractors);
+	free(KeplerX);
+	free(KeplerY);
+	free(KeplerSpeedX);
+	free(KeplerSpeedY);
+
+	States = NULL;
+	StateIndexes = NULL;
+	SourcesX = NULL;
+	SourcesY = NULL;
+	SourcesGravity = NULL;
+	SourcesRadius = NULL;
+	SourceStates = NULL;
+	Hits = NULL;
+	PrevAccelX = NULL;
+	PrevAccelY = NULL;
+	SourcesSpeedX = NULL;
+	SourcesSpeedY = NULL;
+	SourcesSpeed = NULL;
+	Contacted = NULL;
+	Contacts = NULL;
+	ParentStates = NULL;
+	FrameX = NULL;
+	FrameY = NULL;
+	FrameSpeedX = NULL;
+	FrameSpeedY = NULL;
+	FrameAccelX = NULL;
+	FrameAccelY = NULL;
+	SourcesAccelX = NULL;
+	SourcesAccelY = NULL;
+	Attractors = NULL;
+	KeplerStates = NULL;
+	KeplerIndexes = NULL;
+	KeplerParents = NULL;
+	KeplerAttractors = NULL;
+	KeplerX = NULL;
+	KeplerY = NULL;
+	KeplerSpeedX = NULL;
+	KeplerSpeedY = NULL;
+	ContactsNumber = 0;
+	ContactsCapacity = 0;
+	StatesCapacity = 0;
 }
 
 
 // Returns the amount of simulation time a user second represents:
 inline double getTimeScale(void)
 {
-	return FrameTimeMultiplier * REAL_FRAMERATE;
+	return FrameTimeMultiplier * FrameRate;
 }
 
 
@@ -57,13 +195,92 @@ inline double getSimulationTime(void)
 }
 
 
+// Substeps always cover exactly the simulation time of a frame:
+static void updateTimeStep(void)
+{
+	dt = FrameTimeMultiplier / Substeps;
+}
+
+
 inline void changeSimulationSpeed(double time_multiplier)
 {
 	updateSimulationTime();
 
-	dt *= time_multiplier;
-	dt2s2 = dt * dt / (2 - CHEAT);
 	FrameTimeMultiplier *= time_multiplier;
+
+	updateTimeStep();
+}
+
+
+// Sets the number of physics steps per second the simulation is run at, e.g. the display refresh rate
+// when using vsync without drawing interpolation. The time scale is preserved,
+// the simulation time step is updated accordingly.
+void setFrameRate(double framerate)
+{
+	updateSimulationTime();
+
+	double time_scale = getTimeScale();
+
+	FrameRate = framerate;
+	FrameTimeMultiplier = time_scale / framerate;
+
+	updateTimeStep();
+}
+
+
+// Sets the maximum number of substeps per frame, and the number of substeps between two computations of the
+// accelerations, which are reused in between. The simulation time covered by a frame is unchanged.
+void setSubsteps(int substeps, int force_interval)
+{
+	SubstepsLimit = MAX(1, substeps);
+	Substeps = MIN(TargetSubsteps, SubstepsLimit);
+	ForceInterval = MAX(1, force_interval);
+
+	updateTimeStep();
+}
+
+
+// Returns the simulation time covered by a physics step, i.e. by a moveBodies() call, in seconds:
+double getStepDuration(void)
+{
+	return FrameTimeMultiplier;
+}
+
+
+int getSubsteps(void)
+{
+	return Substeps;
+}
+
+
+// Returns the number of substeps per frame needed for accuracy, UPDATES_PER_FRAME without ADAPTIVE_SUBSTEPS:
+int getTargetSubsteps(void)
+{
+	return TargetSubsteps;
+}
+
+
+// Restores a number of substeps per frame returned by getTargetSubsteps(), e.g. after a precomputation:
+void setTargetSubsteps(int target_substeps)
+{
+	TargetSubsteps = MAX(1, target_substeps);
+	Substeps = MIN(TargetSubsteps, SubstepsLimit);
+	StepError = 0.;
+
+	updateTimeStep();
+}
+
+
+// Returns the largest error estimate of the last physics step, see ADAPTIVE_TOLERANCE:
+double getStepError(void)
+{
+	return StepError;
+}
+
+
+int getForceInterval(void)
+{
+	return ForceInterval;
 }
 
 
@@ -83,7 +300,7 @@ inline int collision(Body **bodies, int indexBody1, int indexBody2, double dist)
 	if (body1 == NULL || body2 == NULL)
 		return 1; // No gravity update must be done for this interaction.
 
-	double r1 = body1 -> Radius, r2 = body2 -> Radius;
+	double r1 = body1 -> State -> Radius, r2 = body2 -> State -> Radius;
 
 	int status = r1 + r2 >= dist;
 
@@ -93,38 +310,46 @@ inline int collision(Body **bodies, int indexBody1, int indexBody2, double dist)
 		int indexLostOne = body1 -> Mass > body2 -> Mass ? indexBody2 : indexBody1;
 
 		Body *survivor = bodies[indexSurvivor], *lostOne = bodies[indexLostOne];
+		BodyState *s = survivor -> State, *l = lostOne -> State;
 
 		// Assuming both bodies have same density:
 		double new_radius = pow(r1 * r1 * r1 + r2 * r2 * r2, 1./3.);
 		double ratio = survivor -> Mass / (survivor -> Mass + lostOne -> Mass);
 
-		*(double*) &(survivor -> Radius) = new_radius;
+		*(double*) &(s -> Radius) = new_radius;
 		*(double*) &(survivor -> Mass) += lostOne -> Mass;
-		*(double*) &(survivor -> GravityFactor) = GravitationalConst * survivor -> Mass;
+		*(double*) &(s -> GravityFactor) = GravitationalConst * survivor -> Mass;
 
 		// This is probably quite unrealistic:
-		survivor -> PosX = ratio * survivor -> PosX + (1. - ratio) * lostOne -> PosX;
-		survivor -> PosY = ratio * survivor -> PosY + (1. - ratio) * lostOne -> PosY;
-		survivor -> SpeedX = ratio * survivor -> SpeedX + (1. - ratio) * lostOne -> SpeedX;
-		survivor -> SpeedY = ratio * survivor -> SpeedY + (1. - ratio) * lostOne -> SpeedY;
-		survivor -> AccelX = ratio * survivor -> AccelX + (1. - ratio) * lostOne -> AccelX;
-		survivor -> AccelY = ratio * survivor -> AccelY + (1. - ratio) * lostOne -> AccelY;
+		s -> PosX = ratio * s -> PosX + (1. - ratio) * l -> PosX;
+		s -> PosY = ratio * s -> PosY + (1. - ratio) * l -> PosY;
+		s -> SpeedX = ratio * s -> SpeedX + (1. - ratio) * l -> SpeedX;
+		s -> SpeedY = ratio * s -> SpeedY + (1. - ratio) * l -> SpeedY;
+		s -> AccelX = ratio * s -> AccelX + (1. - ratio) * l -> AccelX;
+		s -> AccelY = ratio * s -> AccelY + (1. - ratio) * l -> AccelY;
+
+		survivor -> PrevPosX = ratio * survivor -> PrevPosX + (1. - ratio) * lostOne -> PrevPosX;
+		survivor -> PrevPosY = ratio * survivor -> PrevPosY + (1. - ratio) * lostOne -> PrevPosY;
 
 		// Removing the absorbed object:
 
+		if (getBody(FollowedBody) == lostOne)
+			FollowedBody = getBodyHandle(survivor);
+
 		freeBody(lostOne);
 		bodies[indexLostOne] = NULL;
-
-		if (IndexFollowedBody == indexLostOne)
-			IndexFollowedBody = indexSurvivor;
 	}
 
 	return status;
 }
 
 
-inline void update_accel_input(Body *ship, Input *input, double thrust)
+// Acceleration given by the ship thrust:
+static void thrustAcceleration(Body *ship, Input *input, double thrust, double *accel_x, double *accel_y)
 {
+	*accel_x = 0.;
+	*accel_y = 0.;
+
 	if (ship == NULL || ship -> Type != Spaceship || ship -> Mass == 0. || input == NULL)
 		return;
 
@@ -132,126 +357,1909 @@ inline void update_accel_input(Body *ship, Input *input, double thrust)
 
 	if (input -> Yinput == UP)
 	{
-		ship -> AccelY -= force;
+		*accel_y -= force;
 	}
 
 	if (input -> Yinput == DOWN)
 	{
-		ship -> AccelY += force;
+		*accel_y += force;
 	}
 
 	if (input -> Xinput == LEFT)
 	{
-		ship -> AccelX -= force;
+		*accel_x -= force;
 	}
 
 	if (input -> Xinput == RIGHT)
 	{
-		ship -> AccelX += force;
+		*accel_x += force;
 	}
 }
 
 
+inline void update_accel_input(Body *ship, Input *input, double thrust)
+{
+	double accel_x, accel_y;
+	thrustAcceleration(ship, input, thrust, &accel_x, &accel_y);
+
+	if (accel_x == 0. && accel_y == 0.)
+		return;
+
+	ship -> State -> AccelX += accel_x;
+	ship -> State -> AccelY += accel_y;
+}
+
+
 // Initialise the buffer array containing the distance for each interaction:
 static void init_DistArray(int interaction_number)
 {
-	if (DistArray)
+	if (interaction_number <= DistCapacity)
 		return;
 
+	free(DistArray);
+
 	DistArray = (double*) calloc(interaction_number, sizeof(double));
+
+	if (DistArray == NULL)
+	{
+		printf("\nNot enough memory for the physics computations.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	DistCapacity = interaction_number;
 }
 
 
-// Updating each positions simultaneously!
-void moveBodies(Body **bodies, int bodies_number, Body *ship, Input *input, double thrust)
+// Light bodies are test particles: they feel the gravity of massive bodies, but neither perturb them nor each other.
+inline int isTestParticle(Body *body)
 {
-	int interaction_number = bodies_number * (bodies_number - 1) / 2;
+	return body -> Mass <= TEST_PARTICLE_MAX_MASS;
+}
 
-	init_DistArray(interaction_number);
 
-	for (int u = 0; u < UPDATES_PER_FRAME; ++u)
+// Gathers the hot part of each body, so that the physics loops don't touch the cold parts.
+// Massive bodies are placed first, then test particles. The previous positions are saved in the same pass,
+// for drawing to interpolate between the two last states:
+static void gatherStates(Body **bodies, int bodies_number)
+{
+	if (bodies_number > StatesCapacity)
 	{
-		// Resetting every accelerations:
+		freePhysicsResources();
+
+		States = (BodyState**) calloc(bodies_number, sizeof(BodyState*));
+		StateIndexes = (int*) calloc(bodies_number, sizeof(int));
+		SourcesX = (double*) calloc(bodies_number, sizeof(double));
+		SourcesY = (double*) calloc(bodies_number, sizeof(double));
+		SourcesGravity = (double*) calloc(bodies_number, sizeof(double));
+		SourcesRadius = (double*) calloc(bodies_number, sizeof(double));
+		SourceStates = (int*) calloc(bodies_number, sizeof(int));
+		Hits = (int*) calloc(bodies_number, sizeof(int));
+		PrevAccelX = (double*) calloc(bodies_number, sizeof(double));
+		PrevAccelY = (double*) calloc(bodies_number, sizeof(double));
+		SourcesSpeedX = (double*) calloc(bodies_number, sizeof(double));
+		SourcesSpeedY = (double*) calloc(bodies_number, sizeof(double));
+		SourcesSpeed = (double*) calloc(bodies_number, sizeof(double));
+		Contacted = (int*) calloc(bodies_number, sizeof(int));
+
+		if (States == NULL || StateIndexes == NULL || SourcesX == NULL || SourcesY == NULL || SourcesGravity == NULL ||
+			SourcesRadius == NULL || SourceStates == NULL || Hits == NULL || PrevAccelX == NULL || PrevAccelY == NULL ||
+			SourcesSpeedX == NULL || SourcesSpeedY == NULL || SourcesSpeed == NULL || Contacted == NULL)
+		{
+			printf("\nNot enough memory for the physics computations.\n");
+			exit(EXIT_FAILURE);
+		}
 
-		for (int i = 0; i < bodies_number; ++i)
+		if (FRAMES_ENABLED)
 		{
-			if (bodies[i] == NULL)
-				continue;
+			ParentStates = (int*) calloc(bodies_number, sizeof(int));
+			FrameX = (double*) calloc(bodies_number, sizeof(double));
+			FrameY = (double*) calloc(bodies_number, sizeof(double));
+			FrameSpeedX = (double*) calloc(bodies_number, sizeof(double));
+			FrameSpeedY = (double*) calloc(bodies_number, sizeof(double));
+			FrameAccelX = (double*) calloc(bodies_number, sizeof(double));
+			FrameAccelY = (double*) calloc(bodies_number, sizeof(double));
+
+			if (ParentStates == NULL || FrameX == NULL || FrameY == NULL || FrameSpeedX == NULL || FrameSpeedY == NULL ||
+				FrameAccelX == NULL || FrameAccelY == NULL)
+			{
+				printf("\nNot enough memory for the reference frames.\n");
+				exit(EXIT_FAILURE);
+			}
+		}
 
-			bodies[i] -> AccelX = 0.;
-			bodies[i] -> AccelY = 0.;
+		if (KEPLER_ENABLED)
+		{
+			SourcesAccelX = (double*) calloc(bodies_number, sizeof(double));
+			SourcesAccelY = (double*) calloc(bodies_number, sizeof(double));
+			Attractors = (int*) calloc(bodies_number, sizeof(int));
+			KeplerStates = (BodyState**) calloc(bodies_number, sizeof(BodyState*));
+			KeplerIndexes = (int*) calloc(bodies_number, sizeof(int));
+			KeplerParents = (int*) calloc(bodies_number, sizeof(int));
+			KeplerAttractors = (int*) calloc(bodies_number, sizeof(int));
+			KeplerX = (double*) calloc(bodies_number, sizeof(double));
+			KeplerY = (double*) calloc(bodies_number, sizeof(double));
+			KeplerSpeedX = (double*) calloc(bodies_number, sizeof(double));
+			KeplerSpeedY = (double*) calloc(bodies_number, sizeof(double));
+
+			if (SourcesAccelX == NULL || SourcesAccelY == NULL || Attractors == NULL || KeplerStates == NULL ||
+				KeplerIndexes == NULL || KeplerParents == NULL || KeplerAttractors == NULL || KeplerX == NULL ||
+				KeplerY == NULL || KeplerSpeedX == NULL || KeplerSpeedY == NULL)
+			{
+				printf("\nNot enough memory for the Kepler fast-forward.\n");
+				exit(EXIT_FAILURE);
+			}
 		}
 
-		// Computing every gravity caused accelerations:
+		StatesCapacity = bodies_number;
+	}
+
+	// In a single pass over the cold parts: test particles are placed from the end, then put back in order:
+
+	int massive_number = 0, test_begin = bodies_number;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		Body *body = bodies[i];
+
+		if (body == NULL)
+			continue;
 
-		#ifdef ENABLE_MULTITHREADING
-			#pragma omp parallel for num_threads(THREAD_NUMBER)
-		#endif
-		for (int i = 0; i < bodies_number - 1; ++i)
+		if (DRAWING_INTERPOLATION == 1)
 		{
-			if (bodies[i] == NULL)
-				continue;
+			body -> PrevPosX = body -> State -> PosX;
+			body -> PrevPosY = body -> State -> PosY;
+		}
 
-			int shift = (bodies_number - 1) * i - (i + 1) * i / 2 - 1; // Computed by hand. Do not factorize by i.
+		int state = isTestParticle(body) ? --test_begin : massive_number++;
 
-			for (int j = i + 1; j < bodies_number; ++j)
-			{
-				if (bodies[j] == NULL)
-					continue;
+		States[state] = body -> State;
+		StateIndexes[state] = i;
 
-				DistArray[shift + j] = distance(bodies[i] -> PosX, bodies[i] -> PosY, bodies[j] -> PosX, bodies[j] -> PosY);
-			}
+		body -> StateIndex = state; // Final for massive bodies only, which are the only possible parents.
+	}
+
+	int test_number = bodies_number - test_begin;
+
+	for (int t = 0; t < test_number / 2; ++t)
+	{
+		int first = test_begin + t, last = bodies_number - 1 - t;
+
+		BodyState *state = States[first];
+		States[first] = States[last];
+		States[last] = state;
+
+		int index = StateIndexes[first];
+		StateIndexes[first] = StateIndexes[last];
+		StateIndexes[last] = index;
+	}
+
+	memmove(States + massive_number, States + test_begin, test_number * sizeof(BodyState*));
+	memmove(StateIndexes + massive_number, StateIndexes + test_begin, test_number * sizeof(int));
+
+	MassiveNumber = massive_number;
+	StatesNumber = massive_number + test_number;
+	IntegratedNumber = StatesNumber;
+
+	if (FRAMES_ENABLED)
+	{
+		for (int i = 0; i < StatesNumber; ++i)
+		{
+			Body *parent = getParent(bodies[StateIndexes[i]]);
+
+			ParentStates[i] = parent == NULL ? -1 : parent -> StateIndex;
 		}
+	}
+}
+
+
+// Embedded error estimate of a substep: the difference between the speed changes given by the accelerations
+// at its start (Euler) and by their mean over it (trapezoidal rule), relative to the speed. It is returned
+// squared, for being vectorized without square roots. Bodies without previous accelerations, e.g. just created,
+// are skipped:
+static inline double stepErrorSquared(double accel_x, double accel_y, double prev_accel_x, double prev_accel_y,
+	double speed_x, double speed_y, double step)
+{
+	double delta_x = accel_x - prev_accel_x, delta_y = accel_y - prev_accel_y;
+	double accel_squared = accel_x * accel_x + accel_y * accel_y;
+	double speed_squared = speed_x * speed_x + speed_y * speed_y;
+
+	double scale_squared = speed_squared + accel_squared * step * step;
+
+	int skipped = (prev_accel_x == 0. && prev_accel_y == 0.) || scale_squared == 0.;
 
-		// Applying on each body the acceleration change due to the gravitational effect:
+	return skipped ? 0. : 0.25 * step * step * (delta_x * delta_x + delta_y * delta_y) / scale_squared;
+}
+
+
+// Removes from States the bodies absorbed by collisions:
+static inline void refreshState(Body **bodies, int state)
+{
+	if (bodies[StateIndexes[state]] == NULL)
+		States[state] = NULL;
+}
+
+
+// With REFERENCE_FRAMES, computes the absolute positions and speeds of the massive bodies, by summing their local
+// ones with the ones of their parents:
+static void gatherFrames(void)
+{
+	for (int i = 0; i < MassiveNumber; ++i)
+	{
+		BodyState *state = States[i];
+
+		if (state == NULL)
+			continue;
 
-		int index = 0;
+		double x = state -> PosX, y = state -> PosY, speed_x = state -> SpeedX, speed_y = state -> SpeedY;
 
-		for (int i = 0; i < bodies_number - 1; ++i)
+		for (int parent = ParentStates[i]; parent != -1; parent = ParentStates[parent])
 		{
-			for (int j = i + 1; j < bodies_number; ++j)
-			{
-				double dist = DistArray[index];
+			x += States[parent] -> PosX;
+			y += States[parent] -> PosY;
+			speed_x += States[parent] -> SpeedX;
+			speed_y += States[parent] -> SpeedY;
+		}
+
+		FrameX[i] = x;
+		FrameY[i] = y;
+		FrameSpeedX[i] = speed_x;
+		FrameSpeedY[i] = speed_y;
+	}
+}
+
 
-				++index;
+// With REFERENCE_FRAMES, position of the massive state j relative to the massive state i. Local positions are
+// used when one is the parent of the other or when they have the same parent, which are the cases where the
+// distance is small compared to the distance to the origin:
+static inline void relativePosition(int i, int j, double *dx, double *dy)
+{
+	BodyState *si = States[i], *sj = States[j];
+	int parent_i = ParentStates[i], parent_j = ParentStates[j];
 
-				if (collision(bodies, i, j, dist))
-					continue;
+	*dx = parent_i == parent_j ? sj -> PosX - si -> PosX : parent_j == i ? sj -> PosX :
+		parent_i == j ? -si -> PosX : FrameX[j] - FrameX[i];
 
-				// NULL checks have been done during the collision, and dist_cubed must be > 0,
-				// therefore gravity updates can be done:
+	*dy = parent_i == parent_j ? sj -> PosY - si -> PosY : parent_j == i ? sj -> PosY :
+		parent_i == j ? -si -> PosY : FrameY[j] - FrameY[i];
+}
 
-				double dist_cubed = dist * dist * dist;
 
-				double scal_x = (bodies[j] -> PosX - bodies[i] -> PosX) / dist_cubed;
-				double scal_y = (bodies[j] -> PosY - bodies[i] -> PosY) / dist_cubed;
+// Same as relativePosition(), for speeds:
+static inline void relativeSpeed(int i, int j, double *dvx, double *dvy)
+{
+	BodyState *si = States[i], *sj = States[j];
+	int parent_i = ParentStates[i], parent_j = ParentStates[j];
 
-				bodies[i] -> AccelX += bodies[j] -> GravityFactor * scal_x;
-				bodies[i] -> AccelY += bodies[j] -> GravityFactor * scal_y;
+	*dvx = parent_i == parent_j ? sj -> SpeedX - si -> SpeedX : parent_j == i ? sj -> SpeedX :
+		parent_i == j ? -si -> SpeedX : FrameSpeedX[j] - FrameSpeedX[i];
 
-				bodies[j] -> AccelX -= bodies[i] -> GravityFactor * scal_x;
-				bodies[j] -> AccelY -= bodies[i] -> GravityFactor * scal_y;
-			}
+	*dvy = parent_i == parent_j ? sj -> SpeedY - si -> SpeedY : parent_j == i ? sj -> SpeedY :
+		parent_i == j ? -si -> SpeedY : FrameSpeedY[j] - FrameSpeedY[i];
+}
+
+
+// With REFERENCE_FRAMES, the accelerations of the massive bodies are computed as absolute ones. They are saved
+// for the test particles, then made relative to the ones of the parents:
+static void localAccelerations(void)
+{
+	for (int i = 0; i < MassiveNumber; ++i)
+	{
+		if (States[i] == NULL)
+			continue;
+
+		FrameAccelX[i] = States[i] -> AccelX;
+		FrameAccelY[i] = States[i] -> AccelY;
+	}
+
+	for (int i = 0; i < MassiveNumber; ++i)
+	{
+		if (States[i] == NULL || ParentStates[i] == -1)
+			continue;
+
+		States[i] -> AccelX -= FrameAccelX[ParentStates[i]];
+		States[i] -> AccelY -= FrameAccelY[ParentStates[i]];
+	}
+}
+
+
+// With REFERENCE_FRAMES, prepares the merging of two states: the children of the lost one are given to the survivor,
+// or to the parent of the lost one if they are the survivor or one of its parents, and the lost one is expressed in
+// the frame of the survivor. The children of the survivor follow it. Accelerations are merged as they are: either
+// both absolute ones while being computed, or local ones weighted by the negligible mass of a test particle:
+static void shareFrame(Body **bodies, int survivor, int lost)
+{
+	Body *survivor_body = bodies[StateIndexes[survivor]], *lost_body = bodies[StateIndexes[lost]];
+
+	if (!isTestParticle(lost_body))
+	{
+		Body *grand_parent = getParent(lost_body);
+
+		for (int i = 0; i < StatesNumber; ++i)
+		{
+			if (States[i] == NULL || ParentStates[i] != lost)
+				continue;
+
+			Body *child = bodies[StateIndexes[i]];
+
+			int adopted = child != survivor_body && !isAncestor(child, survivor_body);
+
+			setParent(child, adopted ? survivor_body : grand_parent, 0);
+
+			ParentStates[i] = adopted ? survivor : ParentStates[lost];
 		}
+	}
 
-		// Managing the ship thrust after the gravity effect, to not erase it:
+	setParent(lost_body, getParent(survivor_body), 0);
 
-		update_accel_input(ship, input, thrust);
+	ParentStates[lost] = ParentStates[survivor];
+}
 
-		// Moving each body:
 
-		for (int i = 0; i < bodies_number; ++i)
+// Merges two states with collision(), after having moved both by their speeds times 'time'. The survivor is then
+// moved back along its new speed, for the next substeps to bring it to its correct place:
+static void mergeStates(Body **bodies, int first, int second, double dist, double time)
+{
+	if (!CollisionsEnabled || States[first] == NULL || States[second] == NULL)
+		return;
+
+	int massive = !isTestParticle(bodies[StateIndexes[first]]) && !isTestParticle(bodies[StateIndexes[second]]);
+
+	if (FRAMES_ENABLED)
+	{
+		// Same survivor as in collision():
+		int first_survives = bodies[StateIndexes[first]] -> Mass > bodies[StateIndexes[second]] -> Mass;
+
+		shareFrame(bodies, first_survives ? first : second, first_survives ? second : first);
+	}
+
+	BodyState *pair[] = {States[first], States[second]};
+
+	for (int k = 0; k < 2; ++k)
+	{
+		pair[k] -> PosX += pair[k] -> SpeedX * time;
+		pair[k] -> PosY += pair[k] -> SpeedY * time;
+	}
+
+	collision(bodies, StateIndexes[first], StateIndexes[second], dist);
+
+	refreshState(bodies, first);
+	refreshState(bodies, second);
+
+	BodyState *survivor = States[first] != NULL ? States[first] : States[second];
+
+	survivor -> PosX -= survivor -> SpeedX * time;
+	survivor -> PosY -= survivor -> SpeedY * time;
+
+	// The frames of the children of the survivor have moved:
+
+	if (FRAMES_ENABLED && massive)
+		gatherFrames();
+}
+
+
+// Merges the bodies of the given range of States with the ones they overlap, according to Hits.
+// Overlaps having been detected before moving the bodies, those are merged whatever their current distance:
+static void resolveHits(Body **bodies, int begin, int end)
+{
+	if (!CollisionsEnabled)
+		return;
+
+	for (int i = begin; i < end; ++i)
+	{
+		int other = Hits[i];
+
+		if (other == -1)
+			continue;
+
+		mergeStates(bodies, other, i, 0., 0.);
+	}
+}
+
+
+// Earliest time in [0, horizon] at which two bodies, moving in straight lines, are distant of 'reach'. Their
+// relative position is (dx, dy), their relative speed (dvx, dvy). Returns -1 if they don't come that close:
+static inline double contactTime(double dx, double dy, double dvx, double dvy, double reach, double horizon)
+{
+	double approach = -(dx * dvx + dy * dvy); // Positive when getting closer.
+
+	if (approach <= 0.)
+		return -1.;
+
+	double speed_squared = dvx * dvx + dvy * dvy;
+	double gap = dx * dx + dy * dy - reach * reach;
+	double discriminant = approach * approach - speed_squared * gap;
+
+	if (discriminant < 0.)
+		return -1.;
+
+	double time = gap / (approach + sqrt(discriminant)); // Smallest root, without cancellation.
+
+	return time <= horizon ? time : -1.;
+}
+
+
+static void addContact(double time, int first, int second)
+{
+	if (ContactsNumber == ContactsCapacity)
+	{
+		int capacity = MAX(16, 2 * ContactsCapacity);
+
+		Contact *contacts = (Contact*) realloc(Contacts, capacity * sizeof(Contact));
+
+		if (contacts == NULL)
 		{
-			Body *body = bodies[i];
+			printf("\nNot enough memory for the collisions.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		Contacts = contacts;
+		ContactsCapacity = capacity;
+	}
+
+	Contacts[ContactsNumber++] = (Contact) {time, first, second};
+}
+
+
+// By time, then by indexes for the order not to depend on the sort implementation:
+static int compareContacts(const void *contact1, const void *contact2)
+{
+	const Contact *c1 = (const Contact*) contact1, *c2 = (const Contact*) contact2;
+
+	if (c1 -> Time != c2 -> Time)
+		return c1 -> Time < c2 -> Time ? -1 : 1;
+
+	if (c1 -> First != c2 -> First)
+		return c1 -> First - c2 -> First;
+
+	return c1 -> Second - c2 -> Second;
+}
+
+
+// Merges the massive bodies which come into contact before the next computation of the accelerations, in the order
+// of their contact times, at their positions at that time. Bodies which have already merged are skipped,
+// their trajectory having changed: their contacts are looked for again at the next computation.
+static void resolveContacts(Body **bodies)
+{
+	qsort(Contacts, ContactsNumber, sizeof(Contact), compareContacts);
+
+	for (int c = 0; c < ContactsNumber; ++c)
+	{
+		int first = Contacts[c].First, second = Contacts[c].Second;
+		double time = Contacts[c].Time;
+
+		if (States[first] == NULL || States[second] == NULL || Contacted[first] || Contacted[second])
+			continue;
+
+		mergeStates(bodies, first, second, 0., time);
+
+		Contacted[first] = 1;
+		Contacted[second] = 1;
+	}
 
-			if (body == NULL)
+	ContactsNumber = 0;
+}
+
+
+// Computes the accelerations of every massive body, caused by gravity and by the ship thrust.
+// With approximate solvers, test particles are included, their gravity being negligible. With CONTINUOUS_COLLISIONS,
+// bodies which would come into contact within 'horizon' seconds are merged at their contact time. With
+// REFERENCE_FRAMES, accelerations are made relative to the ones of the parents:
+static void computeAccelerations(Body **bodies, Body *ship, Input *input, double thrust, double horizon)
+{
+	int ship_included = ship != NULL && (GRAVITY_SOLVER != 0 || !isTestParticle(ship));
+
+	if (GRAVITY_SOLVER != 0)
+	{
+		if (GRAVITY_SOLVER == 1)
+			computeAccelerationsPM(States, StatesNumber);
+		else
+			computeAccelerationsFMM(States, StatesNumber);
+
+		if (ship_included)
+			update_accel_input(ship, input, thrust);
+
+		return;
+	}
+
+	int massive_number = MassiveNumber;
+	int sweeping = CONTINUOUS_COLLISIONS && CollisionsEnabled;
+
+	// Resetting every accelerations:
+
+	for (int i = 0; i < massive_number; ++i)
+	{
+		Contacted[i] = 0;
+
+		if (States[i] == NULL)
+			continue;
+
+		States[i] -> AccelX = 0.;
+		States[i] -> AccelY = 0.;
+	}
+
+	if (FRAMES_ENABLED)
+		gatherFrames();
+
+	// Computing every gravity caused accelerations:
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(THREAD_NUMBER)
+	#endif
+	for (int i = 0; i < massive_number - 1; ++i)
+	{
+		if (States[i] == NULL)
+			continue;
+
+		int shift = (massive_number - 1) * i - (i + 1) * i / 2 - 1; // Computed by hand. Do not factorize by i.
+
+		for (int j = i + 1; j < massive_number; ++j)
+		{
+			if (States[j] == NULL)
 				continue;
 
-			body -> PosX += body -> SpeedX * dt + body -> AccelX * dt2s2;
-			body -> PosY += body -> SpeedY * dt + body -> AccelY * dt2s2;
+			if (FRAMES_ENABLED)
+			{
+				double dx, dy;
+				relativePosition(i, j, &dx, &dy);
+
+				DistArray[shift + j] = sqrt(dx * dx + dy * dy);
+			}
 
-			body -> SpeedX += body -> AccelX * dt;
-			body -> SpeedY += body -> AccelY * dt;
+			else
+				DistArray[shift + j] = distance(States[i] -> PosX, States[i] -> PosY, States[j] -> PosX, States[j] -> PosY);
 		}
 	}
+
+	// Applying on each body the acceleration change due to the gravitational effect:
+
+	int index = 0;
+
+	for (int i = 0; i < massive_number - 1; ++i)
+	{
+		for (int j = i + 1; j < massive_number; ++j)
+		{
+			double dist = DistArray[index];
+
+			++index;
+
+			BodyState *si = States[i], *sj = States[j];
+
+			if (si == NULL || sj == NULL)
+				continue;
+
+			// Only overlapping bodies need the cold part, for merging:
+
+			if (si -> Radius + sj -> Radius >= dist)
+			{
+				mergeStates(bodies, i, j, dist, 0.);
+
+				Contacted[i] = 1;
+				Contacted[j] = 1;
+
+				continue;
+			}
+
+			double dx = sj -> PosX - si -> PosX, dy = sj -> PosY - si -> PosY;
+
+			if (FRAMES_ENABLED)
+				relativePosition(i, j, &dx, &dy);
+
+			// Bodies may also come into contact between the sampled positions:
+
+			if (sweeping)
+			{
+				double dvx = sj -> SpeedX - si -> SpeedX, dvy = sj -> SpeedY - si -> SpeedY;
+
+				if (FRAMES_ENABLED)
+					relativeSpeed(i, j, &dvx, &dvy);
+
+				double time = contactTime(dx, dy, dvx, dvy, si -> Radius + sj -> Radius, horizon);
+
+				if (time >= 0.)
+					addContact(time, i, j);
+			}
+
+			// dist_cubed must be > 0, therefore gravity updates can be done:
+
+			double dist_cubed = dist * dist * dist;
+
+			double scal_x = dx / dist_cubed;
+			double scal_y = dy / dist_cubed;
+
+			si -> AccelX += sj -> GravityFactor * scal_x;
+			si -> AccelY += sj -> GravityFactor * scal_y;
+
+			sj -> AccelX -= si -> GravityFactor * scal_x;
+			sj -> AccelY -= si -> GravityFactor * scal_y;
+		}
+	}
+
+	if (ContactsNumber > 0)
+		resolveContacts(bodies);
+
+	// Managing the ship thrust after the gravity effect, to not erase it:
+
+	if (ship_included)
+		update_accel_input(ship, input, thrust);
+
+	if (FRAMES_ENABLED)
+		localAccelerations();
+}
+
+
+// Copies the massive bodies in the arrays used by the test particles kernel. Returns their number.
+// With REFERENCE_FRAMES, their absolute positions and speeds are used, the frames having been gathered:
+static int gatherSources(void)
+{
+	int sources_number = 0;
+
+	for (int i = 0; i < MassiveNumber; ++i)
+	{
+		if (States[i] == NULL)
+			continue;
+
+		double speed_x = FRAMES_ENABLED ? FrameSpeedX[i] : States[i] -> SpeedX;
+		double speed_y = FRAMES_ENABLED ? FrameSpeedY[i] : States[i] -> SpeedY;
+
+		SourcesX[sources_number] = FRAMES_ENABLED ? FrameX[i] : States[i] -> PosX;
+		SourcesY[sources_number] = FRAMES_ENABLED ? FrameY[i] : States[i] -> PosY;
+		SourcesGravity[sources_number] = States[i] -> GravityFactor;
+		SourcesRadius[sources_number] = States[i] -> Radius;
+		SourcesSpeedX[sources_number] = speed_x;
+		SourcesSpeedY[sources_number] = speed_y;
+		SourcesSpeed[sources_number] = sqrt(speed_x * speed_x + speed_y * speed_y);
+		SourceStates[sources_number] = i;
+		++sources_number;
+	}
+
+	return sources_number;
+}
+
+
+// Fills a block of the test particles kernel, from the given States. Unused lanes are computed anyway,
+// their results being dropped:
+static inline void loadBlock(int first, int lanes, double *pos_x, double *pos_y, double *radius)
+{
+	for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+	{
+		BodyState *state = l < lanes ? States[first + l] : NULL;
+
+		pos_x[l] = state == NULL ? 0. : state -> PosX;
+		pos_y[l] = state == NULL ? 0. : state -> PosY;
+		radius[l] = state == NULL ? 0. : state -> Radius;
+	}
+}
+
+
+// Returns the first lane of a block holding a particle, 0 if none is left:
+static inline int firstLane(int first, int lanes)
+{
+	for (int l = 0; l < lanes; ++l)
+	{
+		if (States[first + l] != NULL)
+			return l;
+	}
+
+	return 0;
+}
+
+
+// Loads the speeds and the previous accelerations of a block, for the collisions and the error estimate:
+static inline void loadBlockMotion(int first, int lanes, double *speed_x, double *speed_y,
+	double *prev_accel_x, double *prev_accel_y)
+{
+	for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+	{
+		BodyState *state = l < lanes ? States[first + l] : NULL;
+
+		speed_x[l] = state == NULL ? 0. : state -> SpeedX;
+		speed_y[l] = state == NULL ? 0. : state -> SpeedY;
+		prev_accel_x[l] = state == NULL ? 0. : state -> AccelX;
+		prev_accel_y[l] = state == NULL ? 0. : state -> AccelY;
+	}
+}
+
+
+// With REFERENCE_FRAMES, makes the positions and speeds of a block absolute, by adding the ones of their parents:
+static inline void addBlockFrames(int first, int lanes, double *pos_x, double *pos_y, double *speed_x, double *speed_y)
+{
+	for (int l = 0; l < lanes; ++l)
+	{
+		int parent = ParentStates[first + l];
+
+		if (States[first + l] == NULL || parent == -1)
+			continue;
+
+		pos_x[l] += FrameX[parent];
+		pos_y[l] += FrameY[parent];
+		speed_x[l] += FrameSpeedX[parent];
+		speed_y[l] += FrameSpeedY[parent];
+	}
+}
+
+
+// Gravity of the sources on a block of test particles. The index of an overlapped source is stored in 'hit'.
+// With CONTINUOUS_COLLISIONS == 2, particles closer to a source than the distance both may travel within 'horizon'
+// seconds, their speeds being at most 'block_speed', may meet it before the next step: -2 - its index is then
+// stored instead, if no source is overlapped:
+static inline void blockAccelerations(int sources_number, const double *pos_x, const double *pos_y,
+	const double *radius, double horizon, double block_speed, double *accel_x, double *accel_y, int *hit)
+{
+	for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+	{
+		accel_x[l] = 0.;
+		accel_y[l] = 0.;
+		hit[l] = -1;
+	}
+
+	for (int j = 0; j < sources_number; ++j)
+	{
+		double source_x = SourcesX[j], source_y = SourcesY[j];
+		double source_gravity = SourcesGravity[j], source_radius = SourcesRadius[j];
+		double source_extent = source_radius + (SourcesSpeed[j] + block_speed) * horizon;
+
+		#pragma omp simd
+		for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+		{
+			double dx = source_x - pos_x[l];
+			double dy = source_y - pos_y[l];
+
+			double dist_squared = dx * dx + dy * dy;
+			double dist = sqrt(dist_squared);
+
+			// No gravity between overlapping bodies, the particle is to be absorbed:
+			int overlap = dist <= source_radius + radius[l];
+
+			double factor = overlap ? 0. : source_gravity / (dist_squared * dist);
+
+			accel_x[l] += factor * dx;
+			accel_y[l] += factor * dy;
+
+			if (CONTINUOUS_COLLISIONS == 2)
+				hit[l] = overlap ? j : (dist <= source_extent + radius[l] && hit[l] < 0 ? -2 - j : hit[l]);
+			else
+				hit[l] = overlap ? j : hit[l];
+		}
+	}
+}
+
+
+// Same as blockAccelerations(), the terms being computed in single precision, so that twice as many fit in
+// a vector register. Positions are taken relative to the particle of lane 'reference', see firstLane(), for the
+// differences to keep their precision, blocks being compact once bodies are sorted (see reorder.c). The terms are
+// summed in double precision, with Kahan compensation:
+static inline void blockAccelerationsMixed(int sources_number, const double *pos_x, const double *pos_y,
+	const double *radius, int reference, double horizon, double block_speed, double *accel_x, double *accel_y,
+	int *hit)
+{
+	double reference_x = pos_x[reference], reference_y = pos_y[reference];
+
+	float relative_x[TEST_PARTICLE_BLOCK], relative_y[TEST_PARTICLE_BLOCK], radius_f[TEST_PARTICLE_BLOCK];
+	double sum_x[TEST_PARTICLE_BLOCK], sum_y[TEST_PARTICLE_BLOCK];
+	double compensation_x[TEST_PARTICLE_BLOCK], compensation_y[TEST_PARTICLE_BLOCK];
+
+	for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+	{
+		relative_x[l] = (float) (pos_x[l] - reference_x);
+		relative_y[l] = (float) (pos_y[l] - reference_y);
+		radius_f[l] = (float) radius[l];
+
+		sum_x[l] = 0.;
+		sum_y[l] = 0.;
+		compensation_x[l] = 0.;
+		compensation_y[l] = 0.;
+		hit[l] = -1;
+	}
+
+	// Sources are taken by pairs, whose terms are added in single precision before being accumulated. The last source
+	// of an odd number is paired with itself, its second term being weighted by 0:
+	for (int j = 0; j < sources_number; j += 2)
+	{
+		int pair[2] = {j, MIN(j + 1, sources_number - 1)};
+		float source_x[2], source_y[2], source_gravity[2], source_radius[2], source_extent[2];
+
+		for (int p = 0; p < 2; ++p)
+		{
+			int k = pair[p];
+
+			source_x[p] = (float) (SourcesX[k] - reference_x);
+			source_y[p] = (float) (SourcesY[k] - reference_y);
+			source_gravity[p] = p == 0 || pair[1] > j ? (float) SourcesGravity[k] : 0.f;
+			source_radius[p] = (float) SourcesRadius[k];
+			source_extent[p] = (float) (SourcesRadius[k] + (SourcesSpeed[k] + block_speed) * horizon);
+		}
+
+		#pragma omp simd
+		for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+		{
+			float pair_x = 0.f, pair_y = 0.f;
+
+			for (int p = 0; p < 2; ++p)
+			{
+				float dx = source_x[p] - relative_x[l];
+				float dy = source_y[p] - relative_y[l];
+
+				float dist = sqrtf(dx * dx + dy * dy);
+				float inverse = 1.f / dist;
+
+				int overlap = dist <= source_radius[p] + radius_f[l];
+
+				// In that order, for the factor not to overflow nor underflow at astronomical distances:
+				float factor = overlap ? 0.f : source_gravity[p] * inverse * inverse * inverse;
+
+				pair_x += factor * dx;
+				pair_y += factor * dy;
+
+				// Idempotent, so that a source paired with itself is fine:
+				if (CONTINUOUS_COLLISIONS == 2)
+				{
+					int close = dist <= source_extent[p] + radius_f[l];
+					hit[l] = overlap ? pair[p] : (close && hit[l] < 0 ? -2 - pair[p] : hit[l]);
+				}
+				else
+					hit[l] = overlap ? pair[p] : hit[l];
+			}
+
+			double term_x = (double) pair_x - compensation_x[l];
+			double term_y = (double) pair_y - compensation_y[l];
+
+			double new_sum_x = sum_x[l] + term_x;
+			double new_sum_y = sum_y[l] + term_y;
+
+			compensation_x[l] = (new_sum_x - sum_x[l]) - term_x;
+			compensation_y[l] = (new_sum_y - sum_y[l]) - term_y;
+
+			sum_x[l] = new_sum_x;
+			sum_y[l] = new_sum_y;
+		}
+	}
+
+	for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+	{
+		accel_x[l] = sum_x[l] - compensation_x[l];
+		accel_y[l] = sum_y[l] - compensation_y[l];
+	}
+}
+
+
+// Computes the accelerations of the test particles, caused by the massive bodies and by the ship thrust,
+// and moves them with the given time step in the same pass. Test particles are processed by blocks of
+// TEST_PARTICLE_BLOCK, each block being vectorized over its particles:
+static void moveTestParticles(Body **bodies, Body *ship, Input *input, double thrust, double step)
+{
+	double step2s2 = step * step / (2 - CHEAT);
+
+	BodyState *ship_state = ship != NULL && isTestParticle(ship) ? ship -> State : NULL;
+
+	double thrust_x, thrust_y;
+	thrustAcceleration(ship, input, thrust, &thrust_x, &thrust_y);
+
+	// With REFERENCE_FRAMES, gravity is computed from absolute positions, the accelerations being then made relative
+	// to the ones of the parents. The kernel is unchanged, the precision of the positions mattering when they
+	// are integrated rather than for the gravity terms:
+
+	if (FRAMES_ENABLED)
+		gatherFrames();
+
+	int sources_number = gatherSources();
+
+	int test_number = IntegratedNumber - MassiveNumber;
+	int blocks_number = (test_number + TEST_PARTICLE_BLOCK - 1) / TEST_PARTICLE_BLOCK;
+	int hits_number = 0;
+	double error = 0.;
+
+	// Test particles are independent, and evenly split between threads:
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(TEST_PARTICLE_THREADS) schedule(static) reduction(+:hits_number) \
+			reduction(max:error)
+	#endif
+	for (int block = 0; block < blocks_number; ++block)
+	{
+		int first = MassiveNumber + block * TEST_PARTICLE_BLOCK;
+		int lanes = MIN(TEST_PARTICLE_BLOCK, IntegratedNumber - first);
+
+		double pos_x[TEST_PARTICLE_BLOCK], pos_y[TEST_PARTICLE_BLOCK], radius[TEST_PARTICLE_BLOCK];
+		double accel_x[TEST_PARTICLE_BLOCK], accel_y[TEST_PARTICLE_BLOCK];
+		double speed_x[TEST_PARTICLE_BLOCK], speed_y[TEST_PARTICLE_BLOCK];
+		double prev_accel_x[TEST_PARTICLE_BLOCK], prev_accel_y[TEST_PARTICLE_BLOCK];
+		int hit[TEST_PARTICLE_BLOCK];
+
+		loadBlock(first, lanes, pos_x, pos_y, radius);
+		loadBlockMotion(first, lanes, speed_x, speed_y, prev_accel_x, prev_accel_y);
+
+		if (FRAMES_ENABLED)
+			addBlockFrames(first, lanes, pos_x, pos_y, speed_x, speed_y);
+
+		double block_speed_squared = 0.;
+
+		if (CONTINUOUS_COLLISIONS == 2)
+		{
+			for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+				block_speed_squared = MAX(block_speed_squared, speed_x[l] * speed_x[l] + speed_y[l] * speed_y[l]);
+		}
+
+		double block_speed = sqrt(block_speed_squared);
+
+		if (MIXED_PRECISION)
+			blockAccelerationsMixed(sources_number, pos_x, pos_y, radius, firstLane(first, lanes), step, block_speed,
+				accel_x, accel_y, hit);
+		else
+			blockAccelerations(sources_number, pos_x, pos_y, radius, step, block_speed, accel_x, accel_y, hit);
+
+		for (int l = 0; l < lanes; ++l)
+		{
+			BodyState *state = States[first + l];
+
+			// Checking whether a particle near a source meets it before the next step, both moving in straight lines:
+
+			if (hit[l] <= -2)
+			{
+				int source = -2 - hit[l];
+
+				hit[l] = state != NULL && contactTime(SourcesX[source] - pos_x[l], SourcesY[source] - pos_y[l],
+					SourcesSpeedX[source] - speed_x[l], SourcesSpeedY[source] - speed_y[l],
+					SourcesRadius[source] + radius[l], step) >= 0. ? source : -1;
+			}
+
+			Hits[first + l] = state == NULL || hit[l] == -1 ? -1 : SourceStates[hit[l]];
+
+			if (state == NULL)
+				continue;
+
+			if (FRAMES_ENABLED && ParentStates[first + l] != -1)
+			{
+				accel_x[l] -= FrameAccelX[ParentStates[first + l]];
+				accel_y[l] -= FrameAccelY[ParentStates[first + l]];
+			}
+
+			if (state == ship_state)
+			{
+				accel_x[l] += thrust_x;
+				accel_y[l] += thrust_y;
+			}
+
+			state -> AccelX = accel_x[l];
+			state -> AccelY = accel_y[l];
+
+			state -> PosX += state -> SpeedX * step + state -> AccelX * step2s2;
+			state -> PosY += state -> SpeedY * step + state -> AccelY * step2s2;
+
+			state -> SpeedX += state -> AccelX * step;
+			state -> SpeedY += state -> AccelY * step;
+
+			hits_number += hit[l] != -1;
+		}
+
+		double block_error = 0.;
+
+		#pragma omp simd reduction(max:block_error)
+		for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+			block_error = MAX(block_error, stepErrorSquared(accel_x[l], accel_y[l], prev_accel_x[l], prev_accel_y[l],
+				speed_x[l], speed_y[l], step));
+
+		error = MAX(error, block_error);
+	}
+
+	StepError = MAX(StepError, sqrt(error));
+
+	// Absorbed particles, out of the parallel loop since bodies are freed:
+
+	if (hits_number > 0)
+		resolveHits(bodies, MassiveNumber, IntegratedNumber);
+}
+
+
+// With KEPLER_FAST_FORWARD, main attractor of each particle of a block, i.e. the source of strongest gravity on it,
+// as a source index. The perturbation is the gravity of the other sources minus the acceleration of the attractor,
+// i.e. what makes the particle deviate from its Kepler orbit around it: -1 is stored instead if it exceeds
+// KEPLER_PERTURBATION_THRESHOLD times the gravity of the attractor, or if a source is overlapped:
+static inline void blockAttractors(int sources_number, const double *pos_x, const double *pos_y, const double *radius,
+	int *attractor)
+{
+	double main_x[TEST_PARTICLE_BLOCK], main_y[TEST_PARTICLE_BLOCK], main_squared[TEST_PARTICLE_BLOCK];
+	double total_x[TEST_PARTICLE_BLOCK], total_y[TEST_PARTICLE_BLOCK];
+	int overlapping[TEST_PARTICLE_BLOCK];
+
+	for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+	{
+		main_x[l] = 0.;
+		main_y[l] = 0.;
+		main_squared[l] = 0.;
+		total_x[l] = 0.;
+		total_y[l] = 0.;
+		overlapping[l] = 0;
+		attractor[l] = -1;
+	}
+
+	for (int j = 0; j < sources_number; ++j)
+	{
+		double source_x = SourcesX[j], source_y = SourcesY[j];
+		double source_gravity = SourcesGravity[j], source_radius = SourcesRadius[j];
+
+		#pragma omp simd
+		for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+		{
+			double dx = source_x - pos_x[l];
+			double dy = source_y - pos_y[l];
+
+			double dist_squared = dx * dx + dy * dy;
+			double dist = sqrt(dist_squared);
+
+			int overlap = dist <= source_radius + radius[l];
+
+			double factor = overlap ? 0. : source_gravity / (dist_squared * dist);
+			double term_x = factor * dx, term_y = factor * dy;
+			double term_squared = term_x * term_x + term_y * term_y;
+
+			int strongest = term_squared > main_squared[l];
+
+			main_x[l] = strongest ? term_x : main_x[l];
+			main_y[l] = strongest ? term_y : main_y[l];
+			main_squared[l] = strongest ? term_squared : main_squared[l];
+			attractor[l] = strongest ? j : attractor[l];
+
+			total_x[l] += term_x;
+			total_y[l] += term_y;
+			overlapping[l] |= overlap;
+		}
+	}
+
+	const double threshold_squared = KEPLER_PERTURBATION_THRESHOLD * KEPLER_PERTURBATION_THRESHOLD;
+
+	for (int l = 0; l < TEST_PARTICLE_BLOCK; ++l)
+	{
+		int j = attractor[l];
+
+		if (j == -1)
+			continue;
+
+		double perturbation_x = total_x[l] - main_x[l] - SourcesAccelX[j];
+		double perturbation_y = total_y[l] - main_y[l] - SourcesAccelY[j];
+
+		double perturbation_squared = perturbation_x * perturbation_x + perturbation_y * perturbation_y;
+
+		if (overlapping[l] || perturbation_squared > threshold_squared * main_squared[l])
+			attractor[l] = -1;
+	}
+}
+
+
+// With KEPLER_FAST_FORWARD, position and speed of the frame of the given parent state, -1 for the absolute one,
+// relative to the given massive state. They are exactly zero when the attractor is the parent, as is often
+// the case with REFERENCE_FRAMES. The frames must have been gathered:
+static inline void attractorOffset(int parent, int attractor, double *x, double *y, double *speed_x, double *speed_y)
+{
+	if (parent == attractor)
+	{
+		*x = 0.;
+		*y = 0.;
+		*speed_x = 0.;
+		*speed_y = 0.;
+		return;
+	}
+
+	BodyState *state = States[attractor];
+
+	*x = parent == -1 ? 0. : FrameX[parent];
+	*y = parent == -1 ? 0. : FrameY[parent];
+	*speed_x = parent == -1 ? 0. : FrameSpeedX[parent];
+	*speed_y = parent == -1 ? 0. : FrameSpeedY[parent];
+
+	*x -= FRAMES_ENABLED ? FrameX[attractor] : state -> PosX;
+	*y -= FRAMES_ENABLED ? FrameY[attractor] : state -> PosY;
+	*speed_x -= FRAMES_ENABLED ? FrameSpeedX[attractor] : state -> SpeedX;
+	*speed_y -= FRAMES_ENABLED ? FrameSpeedY[attractor] : state -> SpeedY;
+}
+
+
+// With KEPLER_FAST_FORWARD, finds the test particles to be moved along their Kepler orbit during the coming step,
+// see blockAttractors(), whose orbit doesn't come closer to their attractor than its radius, and which aren't
+// the ship, for its thrust to be applied. Those are placed after the integrated ones, their positions and speeds
+// relative to their attractor being saved:
+static void prepareKeplerStates(Body **bodies, Body *ship)
+{
+	if (FRAMES_ENABLED)
+		gatherFrames();
+
+	int sources_number = gatherSources();
+
+	for (int j = 0; j < sources_number; ++j)
+		getAbsoluteAcceleration(bodies[StateIndexes[SourceStates[j]]], SourcesAccelX + j, SourcesAccelY + j);
+
+	BodyState *ship_state = ship != NULL ? ship -> State : NULL;
+
+	int test_number = StatesNumber - MassiveNumber;
+	int blocks_number = (test_number + TEST_PARTICLE_BLOCK - 1) / TEST_PARTICLE_BLOCK;
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(TEST_PARTICLE_THREADS) schedule(static)
+	#endif
+	for (int block = 0; block < blocks_number; ++block)
+	{
+		int first = MassiveNumber + block * TEST_PARTICLE_BLOCK;
+		int lanes = MIN(TEST_PARTICLE_BLOCK, StatesNumber - first);
+
+		double pos_x[TEST_PARTICLE_BLOCK], pos_y[TEST_PARTICLE_BLOCK], radius[TEST_PARTICLE_BLOCK];
+		double speed_x[TEST_PARTICLE_BLOCK], speed_y[TEST_PARTICLE_BLOCK];
+		double prev_accel_x[TEST_PARTICLE_BLOCK], prev_accel_y[TEST_PARTICLE_BLOCK];
+		int attractor[TEST_PARTICLE_BLOCK];
+
+		loadBlock(first, lanes, pos_x, pos_y, radius);
+		loadBlockMotion(first, lanes, speed_x, speed_y, prev_accel_x, prev_accel_y);
+
+		if (FRAMES_ENABLED)
+			addBlockFrames(first, lanes, pos_x, pos_y, speed_x, speed_y);
+
+		blockAttractors(sources_number, pos_x, pos_y, radius, attractor);
+
+		for (int l = 0; l < lanes; ++l)
+		{
+			int j = attractor[l];
+
+			int fast_forwarded = j != -1 && States[first + l] != NULL && States[first + l] != ship_state &&
+				keplerPeriapsis(SourcesGravity[j], pos_x[l] - SourcesX[j], pos_y[l] - SourcesY[j],
+					speed_x[l] - SourcesSpeedX[j], speed_y[l] - SourcesSpeedY[j]) > SourcesRadius[j] + radius[l];
+
+			Attractors[first + l] = fast_forwarded ? SourceStates[j] : -1;
+		}
+	}
+
+	// Integrated particles are packed in order, the other ones being appended after them:
+
+	int integrated_number = MassiveNumber, kepler_number = 0;
+
+	for (int i = MassiveNumber; i < StatesNumber; ++i)
+	{
+		int parent = FRAMES_ENABLED ? ParentStates[i] : -1;
+
+		if (Attractors[i] == -1)
+		{
+			States[integrated_number] = States[i];
+			StateIndexes[integrated_number] = StateIndexes[i];
+
+			if (FRAMES_ENABLED)
+				ParentStates[integrated_number] = parent;
+
+			++integrated_number;
+			continue;
+		}
+
+		double x, y, speed_x, speed_y;
+		attractorOffset(parent, Attractors[i], &x, &y, &speed_x, &speed_y);
+
+		KeplerStates[kepler_number] = States[i];
+		KeplerIndexes[kepler_number] = StateIndexes[i];
+		KeplerParents[kepler_number] = parent;
+		KeplerAttractors[kepler_number] = Attractors[i];
+		KeplerX[kepler_number] = States[i] -> PosX + x;
+		KeplerY[kepler_number] = States[i] -> PosY + y;
+		KeplerSpeedX[kepler_number] = States[i] -> SpeedX + speed_x;
+		KeplerSpeedY[kepler_number] = States[i] -> SpeedY + speed_y;
+		++kepler_number;
+	}
+
+	for (int k = 0; k < kepler_number; ++k)
+	{
+		States[integrated_number + k] = KeplerStates[k];
+		StateIndexes[integrated_number + k] = KeplerIndexes[k];
+
+		if (FRAMES_ENABLED)
+			ParentStates[integrated_number + k] = KeplerParents[k];
+	}
+
+	IntegratedNumber = integrated_number;
+}
+
+
+// With KEPLER_FAST_FORWARD, moves the particles listed from IntegratedNumber on along their Kepler orbit, over the
+// whole step of 'time' seconds, their attractor having been integrated. Their accelerations are set for the error
+// estimate of their next integrated substep. A particle whose attractor has merged during the step is left as it
+// was, to be integrated again:
+static void driftKeplerStates(double time)
+{
+	if (FRAMES_ENABLED)
+		gatherFrames();
+
+	int kepler_number = StatesNumber - IntegratedNumber;
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(TEST_PARTICLE_THREADS) schedule(static) if (kepler_number > 4096)
+	#endif
+	for (int k = 0; k < kepler_number; ++k)
+	{
+		int i = IntegratedNumber + k, attractor = KeplerAttractors[k];
+
+		BodyState *state = States[i], *attractor_state = States[attractor];
+
+		if (state == NULL || attractor_state == NULL)
+			continue;
+
+		double mu = attractor_state -> GravityFactor;
+		double x = KeplerX[k], y = KeplerY[k], speed_x = KeplerSpeedX[k], speed_y = KeplerSpeedY[k];
+
+		keplerDrift(mu, &x, &y, &speed_x, &speed_y, time); // Kept at the same place relative to the attractor if failed.
+
+		// The parent may have changed by merging during the step:
+
+		int parent = FRAMES_ENABLED ? ParentStates[i] : -1;
+
+		double offset_x, offset_y, offset_speed_x, offset_speed_y;
+		attractorOffset(parent, attractor, &offset_x, &offset_y, &offset_speed_x, &offset_speed_y);
+
+		state -> PosX = x - offset_x;
+		state -> PosY = y - offset_y;
+		state -> SpeedX = speed_x - offset_speed_x;
+		state -> SpeedY = speed_y - offset_speed_y;
+
+		// Gravity of the attractor, plus its acceleration minus the one of the frame:
+
+		double dist = sqrt(x * x + y * y);
+		double factor = -mu / (dist * dist * dist);
+
+		double accel_x = FRAMES_ENABLED ? FrameAccelX[attractor] : attractor_state -> AccelX;
+		double accel_y = FRAMES_ENABLED ? FrameAccelY[attractor] : attractor_state -> AccelY;
+
+		if (parent == attractor)
+			accel_x = accel_y = 0.;
+
+		else if (parent != -1)
+		{
+			accel_x -= FrameAccelX[parent];
+			accel_y -= FrameAccelY[parent];
+		}
+
+		state -> AccelX = factor * x + accel_x;
+		state -> AccelY = factor * y + accel_y;
+	}
+}
+
+
+// Computes the accelerations caused by the massive bodies on every test particle, without moving them,
+// with the kernel of the given precision. Results are stored in the given arrays, or in the States if NULL:
+static void testParticlesAccelerations(int mixed, double *accel_x, double *accel_y)
+{
+	int sources_number = gatherSources();
+
+	int test_number = StatesNumber - MassiveNumber;
+	int blocks_number = (test_number + TEST_PARTICLE_BLOCK - 1) / TEST_PARTICLE_BLOCK;
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(TEST_PARTICLE_THREADS) schedule(static)
+	#endif
+	for (int block = 0; block < blocks_number; ++block)
+	{
+		int first = MassiveNumber + block * TEST_PARTICLE_BLOCK;
+		int lanes = MIN(TEST_PARTICLE_BLOCK, StatesNumber - first);
+
+		double pos_x[TEST_PARTICLE_BLOCK], pos_y[TEST_PARTICLE_BLOCK], radius[TEST_PARTICLE_BLOCK];
+		double block_accel_x[TEST_PARTICLE_BLOCK], block_accel_y[TEST_PARTICLE_BLOCK];
+		int hit[TEST_PARTICLE_BLOCK];
+
+		loadBlock(first, lanes, pos_x, pos_y, radius);
+
+		// No time horizon, only the accelerations being of interest:
+
+		if (mixed)
+			blockAccelerationsMixed(sources_number, pos_x, pos_y, radius, firstLane(first, lanes), 0., 0.,
+				block_accel_x, block_accel_y, hit);
+		else
+			blockAccelerations(sources_number, pos_x, pos_y, radius, 0., 0., block_accel_x, block_accel_y, hit);
+
+		for (int l = 0; l < lanes; ++l)
+		{
+			BodyState *state = States[first + l];
+
+			if (accel_x != NULL)
+			{
+				accel_x[first - MassiveNumber + l] = block_accel_x[l];
+				accel_y[first - MassiveNumber + l] = block_accel_y[l];
+			}
+
+			else if (state != NULL)
+			{
+				state -> AccelX = block_accel_x[l];
+				state -> AccelY = block_accel_y[l];
+			}
+		}
+	}
+}
+
+
+// Saves the accelerations of the given range of States, before they are computed again:
+static void saveAccelerations(int begin, int end)
+{
+	for (int i = begin; i < end; ++i)
+	{
+		if (States[i] == NULL)
+			continue;
+
+		PrevAccelX[i] = States[i] -> AccelX;
+		PrevAccelY[i] = States[i] -> AccelY;
+	}
+}
+
+
+// Updates the error estimate with the given range of States, 'step' being the time since the saved accelerations:
+static void estimateError(int begin, int end, double step)
+{
+	double error = 0.;
+
+	for (int i = begin; i < end; ++i)
+	{
+		if (States[i] != NULL)
+			error = MAX(error, stepErrorSquared(States[i] -> AccelX, States[i] -> AccelY, PrevAccelX[i], PrevAccelY[i],
+				States[i] -> SpeedX, States[i] -> SpeedY, step));
+	}
+
+	StepError = MAX(StepError, sqrt(error));
+}
+
+
+// Chooses the number of substeps of the next frames, for the error estimate to meet ADAPTIVE_TOLERANCE.
+// The estimate scaling as the square of the time step, the number of substeps scales as its square root:
+static void adaptSubsteps(void)
+{
+	if (!ADAPTIVE_SUBSTEPS || StepError == 0.)
+		return;
+
+	double factor = sqrt(StepError / ADAPTIVE_TOLERANCE) / ADAPTIVE_SAFETY;
+
+	factor = MIN(MAX(factor, ADAPTIVE_MIN_FACTOR), ADAPTIVE_MAX_FACTOR);
+
+	TargetSubsteps = MIN(MAX((int) ceil(Substeps * factor), ADAPTIVE_MIN_SUBSTEPS), ADAPTIVE_MAX_SUBSTEPS);
+	Substeps = MIN(TargetSubsteps, SubstepsLimit);
+
+	updateTimeStep();
+}
+
+
+// Substeps between two moves of the test particles:
+static inline int testInterval(void)
+{
+	return TEST_PARTICLE_SUBSTEPS > 0 ? MAX(1, Substeps / TEST_PARTICLE_SUBSTEPS) : 1;
+}
+
+
+// Moves the given range of States with the given time step:
+static void integrate(int begin, int end, double step)
+{
+	double step2s2 = step * step / (2 - CHEAT); // step * step / 2 if CHEAT = 0, step * step else.
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(THREAD_NUMBER) schedule(static) if (end - begin > 4096)
+	#endif
+	for (int i = begin; i < end; ++i)
+	{
+		BodyState *state = States[i];
+
+		if (state == NULL)
+			continue;
+
+		state -> PosX += state -> SpeedX * step + state -> AccelX * step2s2;
+		state -> PosY += state -> SpeedY * step + state -> AccelY * step2s2;
+
+		state -> SpeedX += state -> AccelX * step;
+		state -> SpeedY += state -> AccelY * step;
+	}
+}
+
+
+// Whole substep of a small system, its first 'massive_number' States being massive bodies and the next 'test_number'
+// integrated test particles: accelerations, error estimate and integration, with the same operations in the same
+// order as computeAccelerations(), moveTestParticles() and integrate(), for the results to be identical. Buffers,
+// previous accelerations and state pointers included, are on the stack, and no parallel region is opened.
+// Instantiated for each numbers of bodies up to SMALL_SYSTEM_MAX_BODIES, loops are unrolled. Returns 0 without
+// changing anything if a state is missing, if bodies overlap, or if they may come into contact before the next
+// substep, the generic path being needed for merging:
+static ALWAYS_INLINE int smallSystemSubstep(int massive_number, int test_number, Body *ship, Input *input, double thrust)
+{
+	double accel_x[SMALL_SYSTEM_MAX_BODIES], accel_y[SMALL_SYSTEM_MAX_BODIES];
+	double speed_x[SMALL_SYSTEM_MAX_BODIES], speed_y[SMALL_SYSTEM_MAX_BODIES];
+	double prev_x[SMALL_SYSTEM_MAX_BODIES], prev_y[SMALL_SYSTEM_MAX_BODIES];
+	BodyState *states[SMALL_SYSTEM_MAX_BODIES];
+
+	int number = massive_number + test_number;
+	int sweeping = CONTINUOUS_COLLISIONS && CollisionsEnabled;
+
+	#pragma GCC unroll 8
+	for (int i = 0; i < number; ++i)
+	{
+		states[i] = States[i];
+
+		if (states[i] == NULL)
+			return 0;
+
+		accel_x[i] = 0.;
+		accel_y[i] = 0.;
+	}
+
+	if (FRAMES_ENABLED)
+		gatherFrames();
+
+	// Gravity between massive bodies:
+
+	#pragma GCC unroll 8
+	for (int i = 0; i < massive_number - 1; ++i)
+	{
+		#pragma GCC unroll 8
+		for (int j = i + 1; j < massive_number; ++j)
+		{
+			BodyState *si = states[i], *sj = states[j];
+
+			double dx = sj -> PosX - si -> PosX, dy = sj -> PosY - si -> PosY;
+
+			if (FRAMES_ENABLED)
+				relativePosition(i, j, &dx, &dy);
+
+			double dist = sqrt(dx * dx + dy * dy);
+
+			if (si -> Radius + sj -> Radius >= dist)
+				return 0;
+
+			if (sweeping)
+			{
+				double dvx = sj -> SpeedX - si -> SpeedX, dvy = sj -> SpeedY - si -> SpeedY;
+
+				if (FRAMES_ENABLED)
+					relativeSpeed(i, j, &dvx, &dvy);
+
+				if (contactTime(dx, dy, dvx, dvy, si -> Radius + sj -> Radius, dt) >= 0.)
+					return 0;
+			}
+
+			double dist_cubed = dist * dist * dist;
+
+			double scal_x = dx / dist_cubed;
+			double scal_y = dy / dist_cubed;
+
+			accel_x[i] += sj -> GravityFactor * scal_x;
+			accel_y[i] += sj -> GravityFactor * scal_y;
+
+			accel_x[j] -= si -> GravityFactor * scal_x;
+			accel_y[j] -= si -> GravityFactor * scal_y;
+		}
+	}
+
+	// Gravity of the massive bodies on the test particles, from absolute positions. With CONTINUOUS_COLLISIONS == 2,
+	// being within reach of a source is enough for using the generic path, which checks the contact:
+
+	double reach_speed_squared = 0.;
+
+	#pragma GCC unroll 8
+	for (int t = massive_number; t < number; ++t)
+	{
+		speed_x[t] = states[t] -> SpeedX;
+		speed_y[t] = states[t] -> SpeedY;
+
+		if (FRAMES_ENABLED && ParentStates[t] != -1)
+		{
+			speed_x[t] += FrameSpeedX[ParentStates[t]];
+			speed_y[t] += FrameSpeedY[ParentStates[t]];
+		}
+
+		reach_speed_squared = MAX(reach_speed_squared, speed_x[t] * speed_x[t] + speed_y[t] * speed_y[t]);
+	}
+
+	#pragma GCC unroll 8
+	for (int t = massive_number; t < number; ++t)
+	{
+		double pos_x = states[t] -> PosX, pos_y = states[t] -> PosY, radius = states[t] -> Radius;
+
+		if (FRAMES_ENABLED && ParentStates[t] != -1)
+		{
+			pos_x += FrameX[ParentStates[t]];
+			pos_y += FrameY[ParentStates[t]];
+		}
+
+		#pragma GCC unroll 8
+		for (int j = 0; j < massive_number; ++j)
+		{
+			double source_x = FRAMES_ENABLED ? FrameX[j] : states[j] -> PosX;
+			double source_y = FRAMES_ENABLED ? FrameY[j] : states[j] -> PosY;
+
+			double dx = source_x - pos_x;
+			double dy = source_y - pos_y;
+
+			double dist_squared = dx * dx + dy * dy;
+			double dist = sqrt(dist_squared);
+
+			if (dist <= states[j] -> Radius + radius)
+				return 0;
+
+			if (CONTINUOUS_COLLISIONS == 2)
+			{
+				double source_speed_x = FRAMES_ENABLED ? FrameSpeedX[j] : states[j] -> SpeedX;
+				double source_speed_y = FRAMES_ENABLED ? FrameSpeedY[j] : states[j] -> SpeedY;
+
+				double reach = states[j] -> Radius + radius + (sqrt(source_speed_x * source_speed_x +
+					source_speed_y * source_speed_y) + sqrt(reach_speed_squared)) * dt;
+
+				if (dist <= reach)
+					return 0;
+			}
+
+			double factor = states[j] -> GravityFactor / (dist_squared * dist);
+
+			accel_x[t] += factor * dx;
+			accel_y[t] += factor * dy;
+		}
+	}
+
+	// No merging needed, the states can be changed. Massive bodies first, their accelerations being those
+	// the test particles accelerations are made relative to, with REFERENCE_FRAMES:
+
+	double massive_error = 0., test_error = 0.;
+
+	#pragma GCC unroll 8
+	for (int i = 0; i < massive_number; ++i)
+	{
+		prev_x[i] = states[i] -> AccelX;
+		prev_y[i] = states[i] -> AccelY;
+
+		states[i] -> AccelX = accel_x[i];
+		states[i] -> AccelY = accel_y[i];
+	}
+
+	if (ship != NULL && !isTestParticle(ship))
+		update_accel_input(ship, input, thrust);
+
+	if (FRAMES_ENABLED)
+		localAccelerations();
+
+	#pragma GCC unroll 8
+	for (int i = 0; i < massive_number; ++i)
+		massive_error = MAX(massive_error, stepErrorSquared(states[i] -> AccelX, states[i] -> AccelY,
+			prev_x[i], prev_y[i], states[i] -> SpeedX, states[i] -> SpeedY, dt));
+
+	double thrust_x, thrust_y;
+	thrustAcceleration(ship, input, thrust, &thrust_x, &thrust_y);
+
+	double step2s2 = dt * dt / (2 - CHEAT);
+
+	#pragma GCC unroll 8
+	for (int t = massive_number; t < number; ++t)
+	{
+		BodyState *state = states[t];
+
+		if (FRAMES_ENABLED && ParentStates[t] != -1)
+		{
+			accel_x[t] -= FrameAccelX[ParentStates[t]];
+			accel_y[t] -= FrameAccelY[ParentStates[t]];
+		}
+
+		if (ship != NULL && state == ship -> State)
+		{
+			accel_x[t] += thrust_x;
+			accel_y[t] += thrust_y;
+		}
+
+		test_error = MAX(test_error, stepErrorSquared(accel_x[t], accel_y[t], state -> AccelX, state -> AccelY,
+			speed_x[t], speed_y[t], dt));
+
+		state -> AccelX = accel_x[t];
+		state -> AccelY = accel_y[t];
+
+		state -> PosX += state -> SpeedX * dt + state -> AccelX * step2s2;
+		state -> PosY += state -> SpeedY * dt + state -> AccelY * step2s2;
+
+		state -> SpeedX += state -> AccelX * dt;
+		state -> SpeedY += state -> AccelY * dt;
+	}
+
+	StepError = MAX(StepError, sqrt(massive_error));
+	StepError = MAX(StepError, sqrt(test_error));
+
+	#pragma GCC unroll 8
+	for (int i = 0; i < massive_number; ++i)
+	{
+		BodyState *state = states[i];
+
+		state -> PosX += state -> SpeedX * dt + state -> AccelX * step2s2;
+		state -> PosY += state -> SpeedY * dt + state -> AccelY * step2s2;
+
+		state -> SpeedX += state -> AccelX * dt;
+		state -> SpeedY += state -> AccelY * dt;
+	}
+
+	return 1;
+}
+
+
+// Kernels moving a whole small system by one substep:
+typedef int (*SmallSystemKernel)(Body *ship, Input *input, double thrust);
+
+#define SMALL_SYSTEM_KERNEL(massive, test) \
+	static int smallSystemSubstep_##massive##_##test(Body *ship, Input *input, double thrust) \
+	{ \
+		return smallSystemSubstep(massive, test, ship, input, thrust); \
+	}
+
+// One instance for each numbers of massive bodies and of test particles, up to SMALL_SYSTEM_MAX_BODIES bodies:
+SMALL_SYSTEM_KERNEL(1, 0) SMALL_SYSTEM_KERNEL(1, 1) SMALL_SYSTEM_KERNEL(1, 2) SMALL_SYSTEM_KERNEL(1, 3)
+SMALL_SYSTEM_KERNEL(1, 4) SMALL_SYSTEM_KERNEL(1, 5) SMALL_SYSTEM_KERNEL(1, 6) SMALL_SYSTEM_KERNEL(1, 7)
+SMALL_SYSTEM_KERNEL(2, 0) SMALL_SYSTEM_KERNEL(2, 1) SMALL_SYSTEM_KERNEL(2, 2) SMALL_SYSTEM_KERNEL(2, 3)
+SMALL_SYSTEM_KERNEL(2, 4) SMALL_SYSTEM_KERNEL(2, 5) SMALL_SYSTEM_KERNEL(2, 6)
+SMALL_SYSTEM_KERNEL(3, 0) SMALL_SYSTEM_KERNEL(3, 1) SMALL_SYSTEM_KERNEL(3, 2) SMALL_SYSTEM_KERNEL(3, 3)
+SMALL_SYSTEM_KERNEL(3, 4) SMALL_SYSTEM_KERNEL(3, 5)
+SMALL_SYSTEM_KERNEL(4, 0) SMALL_SYSTEM_KERNEL(4, 1) SMALL_SYSTEM_KERNEL(4, 2) SMALL_SYSTEM_KERNEL(4, 3)
+SMALL_SYSTEM_KERNEL(4, 4)
+SMALL_SYSTEM_KERNEL(5, 0) SMALL_SYSTEM_KERNEL(5, 1) SMALL_SYSTEM_KERNEL(5, 2) SMALL_SYSTEM_KERNEL(5, 3)
+SMALL_SYSTEM_KERNEL(6, 0) SMALL_SYSTEM_KERNEL(6, 1) SMALL_SYSTEM_KERNEL(6, 2)
+SMALL_SYSTEM_KERNEL(7, 0) SMALL_SYSTEM_KERNEL(7, 1)
+SMALL_SYSTEM_KERNEL(8, 0)
+
+
+// Instances of smallSystemSubstep(), by numbers of massive bodies and of test particles:
+static const SmallSystemKernel SmallSystemKernels[SMALL_SYSTEM_MAX_BODIES + 1][SMALL_SYSTEM_MAX_BODIES + 1] =
+{
+	{NULL},
+	{smallSystemSubstep_1_0, smallSystemSubstep_1_1, smallSystemSubstep_1_2, smallSystemSubstep_1_3,
+		smallSystemSubstep_1_4, smallSystemSubstep_1_5, smallSystemSubstep_1_6, smallSystemSubstep_1_7},
+	{smallSystemSubstep_2_0, smallSystemSubstep_2_1, smallSystemSubstep_2_2, smallSystemSubstep_2_3,
+		smallSystemSubstep_2_4, smallSystemSubstep_2_5, smallSystemSubstep_2_6},
+	{smallSystemSubstep_3_0, smallSystemSubstep_3_1, smallSystemSubstep_3_2, smallSystemSubstep_3_3,
+		smallSystemSubstep_3_4, smallSystemSubstep_3_5},
+	{smallSystemSubstep_4_0, smallSystemSubstep_4_1, smallSystemSubstep_4_2, smallSystemSubstep_4_3,
+		smallSystemSubstep_4_4},
+	{smallSystemSubstep_5_0, smallSystemSubstep_5_1, smallSystemSubstep_5_2, smallSystemSubstep_5_3},
+	{smallSystemSubstep_6_0, smallSystemSubstep_6_1, smallSystemSubstep_6_2},
+	{smallSystemSubstep_7_0, smallSystemSubstep_7_1},
+	{smallSystemSubstep_8_0},
+};
+
+
+// Kernel specialized for the current numbers of bodies, NULL if the generic path is to be used: with more bodies,
+// when accelerations are reused or test particles moved less often, or with MIXED_PRECISION, whose test particles
+// kernel gives different results:
+static SmallSystemKernel smallSystemKernel(void)
+{
+	int test_number = IntegratedNumber - MassiveNumber;
+
+	if (!SMALL_SYSTEM_KERNELS || GRAVITY_SOLVER != 0 || MassiveNumber == 0 || IntegratedNumber > SMALL_SYSTEM_MAX_BODIES ||
+		ForceInterval != 1 || testInterval() != 1 || (MIXED_PRECISION && test_number > 0))
+		return NULL;
+
+	return SmallSystemKernels[MassiveNumber][test_number];
+}
+
+
+// Wisdom-Holman steps, the ship thrust being applied as a kick after each of them:
+static void moveBodiesWisdomHolman(Body **bodies, Body *ship, Input *input, double thrust)
+{
+	double step = FrameTimeMultiplier / WH_STEPS_PER_FRAME;
+
+	for (int u = 0; u < WH_STEPS_PER_FRAME; ++u)
+	{
+		if (stepWisdomHolman(States, StatesNumber, MassiveNumber, step, Hits) > 0)
+			resolveHits(bodies, 0, StatesNumber);
+
+		double thrust_x, thrust_y;
+		thrustAcceleration(ship, input, thrust, &thrust_x, &thrust_y);
+
+		if (thrust_x != 0. || thrust_y != 0.)
+		{
+			ship -> State -> SpeedX += thrust_x * step;
+			ship -> State -> SpeedY += thrust_y * step;
+		}
+	}
+}
+
+
+// Massive bodies follow their precomputed trajectories, only test particles are integrated:
+static void moveBodiesEphemeris(Body **bodies, Body *ship, Input *input, double thrust)
+{
+	double time = getSimulationTime();
+
+	int test_interval = testInterval();
+
+	for (int u = 0; u < Substeps; u += test_interval)
+	{
+		applyEphemeris(time + u * dt);
+
+		moveTestParticles(bodies, ship, input, thrust, MIN(test_interval, Substeps - u) * dt);
+	}
+
+	applyEphemeris(time + FrameTimeMultiplier);
+
+	adaptSubsteps();
+}
+
+
+// Reference accelerations computed by direct sum, without collisions nor thrust, for checking approximate solvers.
+// NULL states are skipped.
+void directAccelerations(BodyState **states, int number, double *accel_x, double *accel_y)
+{
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(THREAD_NUMBER) schedule(dynamic, 64)
+	#endif
+	for (int i = 0; i < number; ++i)
+	{
+		accel_x[i] = 0.;
+		accel_y[i] = 0.;
+
+		if (states[i] == NULL)
+			continue;
+
+		for (int j = 0; j < number; ++j)
+		{
+			if (states[j] == NULL || j == i)
+				continue;
+
+			double dist = distance(states[i] -> PosX, states[i] -> PosY, states[j] -> PosX, states[j] -> PosY);
+			double dist_cubed = dist * dist * dist;
+
+			if (dist_cubed == 0.)
+				continue;
+
+			accel_x[i] += states[j] -> GravityFactor * (states[j] -> PosX - states[i] -> PosX) / dist_cubed;
+			accel_y[i] += states[j] -> GravityFactor * (states[j] -> PosY - states[i] -> PosY) / dist_cubed;
+		}
+	}
+}
+
+
+// Root mean square and maximum of the relative errors of the states accelerations, compared to reference ones:
+void accelerationErrors(BodyState **states, int number, const double *accel_x, const double *accel_y,
+	double *rms_error, double *max_error)
+{
+	double squares_sum = 0.;
+	int compared = 0;
+
+	*max_error = 0.;
+
+	for (int i = 0; i < number; ++i)
+	{
+		double norm = sqrt(accel_x[i] * accel_x[i] + accel_y[i] * accel_y[i]);
+
+		if (states[i] == NULL || norm == 0.)
+			continue;
+
+		double error = distance(states[i] -> AccelX, states[i] -> AccelY, accel_x[i], accel_y[i]) / norm;
+
+		squares_sum += error * error;
+		*max_error = MAX(*max_error, error);
+		++compared;
+	}
+
+	*rms_error = compared == 0 ? 0. : sqrt(squares_sum / compared);
+}
+
+
+// Compares the test particles accelerations computed in mixed precision to the double precision ones,
+// and prints the relative errors and the throughput of both kernels:
+void validateMixedPrecision(Body **bodies, int bodies_number)
+{
+	gatherStates(bodies, bodies_number);
+
+	int test_number = StatesNumber - MassiveNumber, sources_number = gatherSources();
+
+	if (test_number == 0 || sources_number == 0)
+		return;
+
+	double *accel_x = (double*) calloc(test_number, sizeof(double));
+	double *accel_y = (double*) calloc(test_number, sizeof(double));
+
+	if (accel_x == NULL || accel_y == NULL)
+	{
+		printf("\nNot enough memory for the mixed precision validation.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// First runs are not timed, for the threads to be started:
+
+	testParticlesAccelerations(0, accel_x, accel_y);
+
+	double start = realTime();
+
+	testParticlesAccelerations(0, accel_x, accel_y);
+
+	double double_time = realTime() - start;
+
+	testParticlesAccelerations(1, NULL, NULL);
+
+	start = realTime();
+
+	testParticlesAccelerations(1, NULL, NULL);
+
+	double mixed_time = realTime() - start;
+
+	double rms_error, max_error;
+	accelerationErrors(States + MassiveNumber, test_number, accel_x, accel_y, &rms_error, &max_error);
+
+	double interactions = 1e-9 * test_number * sources_number; // In billions.
+
+	printf("Mixed precision validation, %d test particles, %d massive bodies.\n", test_number, sources_number);
+	printf("kernel   rms error   max error   interactions/s\n");
+	printf("double   %9.2e   %9.2e   %12.2fG\n", 0., 0., interactions / double_time);
+	printf("mixed    %9.2e   %9.2e   %12.2fG\n\n", rms_error, max_error, interactions / mixed_time);
+
+	free(accel_x);
+	free(accel_y);
+}
+
+
+// Updating each positions simultaneously!
+void moveBodies(Body **bodies, int bodies_number, Body *ship, Input *input, double thrust)
+{
+	updateReferenceFrames(bodies, bodies_number);
+
+	gatherStates(bodies, bodies_number);
+
+	StepError = 0.;
+
+	if (isEphemerisOn())
+	{
+		if (ephemerisCovers(getSimulationTime() + FrameTimeMultiplier))
+		{
+			moveBodiesEphemeris(bodies, ship, input, thrust);
+			return;
+		}
+
+		// From there, massive bodies are integrated again:
+
+		freeEphemerisResources();
+
+		printf("End of the ephemeris, at %.1f days.\n", getSimulationTime() / (24. * 3600.));
+	}
+
+	if (INTEGRATOR == 1)
+	{
+		moveBodiesWisdomHolman(bodies, ship, input, thrust);
+		return;
+	}
+
+	if (GRAVITY_SOLVER == 0)
+		init_DistArray(MassiveNumber * (MassiveNumber - 1) / 2);
+
+	// With the direct sum, test particles may be integrated with fewer substeps:
+
+	int test_interval = testInterval();
+	int moved_number = GRAVITY_SOLVER == 0 ? MassiveNumber : StatesNumber;
+
+	// Quiescent test particles are only moved at the end of the step, along their Kepler orbit:
+
+	if (KEPLER_ENABLED)
+		prepareKeplerStates(bodies, ship);
+
+	SmallSystemKernel small_system_kernel = smallSystemKernel();
+
+	for (int u = 0; u < Substeps; ++u)
+	{
+		// Small systems are moved by their specialized kernel, unless bodies are to be merged: the general path then
+		// handles the rest of the step, the number of bodies having changed.
+
+		if (small_system_kernel != NULL)
+		{
+			if (small_system_kernel(ship, input, thrust))
+				continue;
+
+			small_system_kernel = NULL;
+		}
+
+		// Accelerations are reused in between, when the governor lowers the quality:
+
+		if (u % ForceInterval == 0)
+		{
+			saveAccelerations(0, moved_number);
+
+			computeAccelerations(bodies, ship, input, thrust, MIN(ForceInterval, Substeps - u) * dt);
+
+			estimateError(0, moved_number, ForceInterval * dt);
+		}
+
+		// Test particles are moved with the massive bodies positions at the start of their time step:
+
+		if (GRAVITY_SOLVER == 0 && u % test_interval == 0)
+			moveTestParticles(bodies, ship, input, thrust, MIN(test_interval, Substeps - u) * dt);
+
+		// Moving each body:
+
+		integrate(0, moved_number, dt);
+	}
+
+	if (KEPLER_ENABLED)
+		driftKeplerStates(Substeps * dt);
+
+	adaptSubsteps();
 }
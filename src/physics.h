@@ -6,7 +6,7 @@
 #include "user_inputs.h"
 
 
-extern int IndexFollowedBody;
+extern BodyHandle FollowedBody;
 extern int CollisionsEnabled;
 extern unsigned int SimulationFrameIndex;
 
@@ -31,6 +31,43 @@ double getSimulationTime(void);
 void changeSimulationSpeed(double time_multiplier);
 
 
+// Sets the number of physics steps per second the simulation is run at, e.g. the display refresh rate
+// when using vsync without drawing interpolation. The time scale is preserved,
+// the simulation time step is updated accordingly.
+void setFrameRate(double framerate);
+
+
+// Largest number of substeps per frame:
+#define MAX_SUBSTEPS (ADAPTIVE_SUBSTEPS ? ADAPTIVE_MAX_SUBSTEPS : UPDATES_PER_FRAME)
+
+
+// Sets the maximum number of substeps per frame, and the number of substeps between two computations of the
+// accelerations, which are reused in between. The simulation time covered by a frame is unchanged.
+void setSubsteps(int substeps, int force_interval);
+
+
+// Returns the simulation time covered by a physics step, i.e. by a moveBodies() call, in seconds:
+double getStepDuration(void);
+
+
+int getSubsteps(void);
+
+
+// Returns the number of substeps per frame needed for accuracy, UPDATES_PER_FRAME without ADAPTIVE_SUBSTEPS:
+int getTargetSubsteps(void);
+
+
+// Restores a number of substeps per frame returned by getTargetSubsteps(), e.g. after a precomputation:
+void setTargetSubsteps(int target_substeps);
+
+
+// Returns the largest error estimate of the last physics step, see ADAPTIVE_TOLERANCE:
+double getStepError(void);
+
+
+int getForceInterval(void);
+
+
 double distance(double x1, double y1, double x2, double y2);
 
 
@@ -40,6 +77,25 @@ int collision(Body **bodies, int indexBody1, int indexBody2, double dist);
 void update_accel_input(Body *ship, Input *input, double thrust);
 
 
+// Light bodies are test particles: they feel the gravity of massive bodies, but neither perturb them nor each other.
+int isTestParticle(Body *body);
+
+
+// Reference accelerations computed by direct sum, without collisions nor thrust, for checking approximate solvers.
+// NULL states are skipped.
+void directAccelerations(BodyState **states, int number, double *accel_x, double *accel_y);
+
+
+// Root mean square and maximum of the relative errors of the states accelerations, compared to reference ones:
+void accelerationErrors(BodyState **states, int number, const double *accel_x, const double *accel_y,
+	double *rms_error, double *max_error);
+
+
+// Compares the test particles accelerations computed in mixed precision to the double precision ones,
+// and prints the relative errors and the throughput of both kernels:
+void validateMixedPrecision(Body **bodies, int bodies_number);
+
+
 // Updating each positions simultaneously!
 void moveBodies(Body **bodies, int bodies_number, Body *ship, Input *input, double thrust);
 
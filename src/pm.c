@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "settings.h"
+#include "pm.h"
+#include "fft.h"
+#include "simulations.h"
+#include "physics.h"
+
+
+#ifdef ENABLE_MULTITHREADING
+	#define PM_THREADS THREAD_NUMBER
+#else
+	#define PM_THREADS 1
+#endif
+
+// Masses are deposited on partial grids, summed afterwards. Their number must not depend on the threads number
+// in deterministic mode, for the sums to be done in the same order:
+#define DEPOSIT_GRIDS (DETERMINISTIC ? DETERMINISTIC_PARTS : PM_THREADS)
+
+#define N PM_GRID_SIZE
+#define M (2 * PM_GRID_SIZE) // Padded grid size, for isolated boundaries.
+
+
+static double complex *Kernel = NULL; // FFT of the accelerations kernel, Kx + i Ky, in grid units.
+static double complex *Grid = NULL; // Masses, then accelerations.
+static double *Deposits = NULL; // DEPOSIT_GRIDS masses grids of size N x N.
+
+
+// The acceleration caused at the offset (dx, dy) from a unit 'GravityFactor' is -(dx, dy) / r^3. Both components
+// are stored in the same complex kernel: the masses being real, a single inverse FFT gives ax + i ay.
+static void initPM(void)
+{
+	if (Kernel != NULL)
+		return;
+
+	Kernel = (double complex*) calloc((size_t) M * M, sizeof(double complex));
+	Grid = (double complex*) calloc((size_t) M * M, sizeof(double complex));
+	Deposits = (double*) calloc((size_t) DEPOSIT_GRIDS * N * N, sizeof(double));
+
+	if (Kernel == NULL || Grid == NULL || Deposits == NULL)
+	{
+		printf("\nNot enough memory for the PM grids.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int iy = 0; iy < M; ++iy)
+	{
+		for (int ix = 0; ix < M; ++ix)
+		{
+			// Offsets in ]-N, N[, wrapped around. The offset N is never used:
+
+			if (ix == N || iy == N || (ix == 0 && iy == 0))
+				continue;
+
+			double dx = ix < N ? ix : ix - M;
+			double dy = iy < N ? iy : iy - M;
+
+			double r = sqrt(dx * dx + dy * dy);
+			double r_cubed = r * r * r;
+
+			Kernel[(size_t) iy * M + ix] = -dx / r_cubed - I * dy / r_cubed;
+		}
+	}
+
+	fft2d(Kernel, M, 0);
+}
+
+
+// Cloud-in-cell cell and weights of a position, in grid units:
+static void cellWeights(double u, double v, int *i, int *j, double *fx, double *fy)
+{
+	*i = MIN(MAX((int) u, 0), N - 2);
+	*j = MIN(MAX((int) v, 0), N - 2);
+
+	*fx = u - *i;
+	*fy = v - *j;
+}
+
+
+// Particle-mesh (PM) gravity: masses are assigned to a PM_GRID_SIZE x PM_GRID_SIZE grid covering the bodies
+// with the cloud-in-cell scheme, the accelerations on the grid are obtained by FFT convolution with the
+// gravity kernel, zero padding giving isolated boundaries, and are interpolated back to the bodies.
+// Forces are therefore smoothed at the scale of a grid cell. NULL states are skipped, accelerations are overwritten.
+void computeAccelerationsPM(BodyState **states, int number)
+{
+	initPM();
+
+	// Square grid centered on the bodies, with half a cell of margin:
+
+	double xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY;
+
+	for (int k = 0; k < number; ++k)
+	{
+		if (states[k] == NULL)
+			continue;
+
+		xmin = MIN(xmin, states[k] -> PosX);
+		xmax = MAX(xmax, states[k] -> PosX);
+		ymin = MIN(ymin, states[k] -> PosY);
+		ymax = MAX(ymax, states[k] -> PosY);
+	}
+
+	if (xmin > xmax)
+		return; // No body.
+
+	double extent = MAX(xmax - xmin, ymax - ymin);
+
+	double h = extent > 0. ? extent / (N - 2) : 1.; // Cell size.
+	double x0 = (xmin + xmax) / 2. - h * (N - 1) / 2.;
+	double y0 = (ymin + ymax) / 2. - h * (N - 1) / 2.;
+
+	// Mass assignment, each part of the bodies on its own grid:
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(PM_THREADS)
+	#endif
+	for (int t = 0; t < DEPOSIT_GRIDS; ++t)
+	{
+		double *deposit = Deposits + (size_t) t * N * N;
+
+		memset(deposit, 0, (size_t) N * N * sizeof(double));
+
+		int begin = (long) number * t / DEPOSIT_GRIDS, end = (long) number * (t + 1) / DEPOSIT_GRIDS;
+
+		for (int k = begin; k < end; ++k)
+		{
+			BodyState *state = states[k];
+
+			if (state == NULL)
+				continue;
+
+			int i, j;
+			double fx, fy;
+			cellWeights((state -> PosX - x0) / h, (state -> PosY - y0) / h, &i, &j, &fx, &fy);
+
+			double g = state -> GravityFactor;
+
+			deposit[j * N + i] += g * (1. - fx) * (1. - fy);
+			deposit[j * N + i + 1] += g * fx * (1. - fy);
+			deposit[(j + 1) * N + i] += g * (1. - fx) * fy;
+			deposit[(j + 1) * N + i + 1] += g * fx * fy;
+		}
+	}
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(PM_THREADS)
+	#endif
+	for (int row = 0; row < M; ++row)
+	{
+		double complex *line = Grid + (size_t) row * M;
+
+		memset(line, 0, M * sizeof(double complex));
+
+		if (row >= N)
+			continue;
+
+		for (int t = 0; t < DEPOSIT_GRIDS; ++t)
+		{
+			double *deposit = Deposits + (size_t) t * N * N + (size_t) row * N;
+
+			for (int col = 0; col < N; ++col)
+				line[col] += deposit[col];
+		}
+	}
+
+	// Convolution. Kernel is in grid units, hence the 1 / h^2 factor:
+
+	fft2d(Grid, M, 0);
+
+	const double factor = 1. / ((double) M * M * h * h);
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(PM_THREADS)
+	#endif
+	for (int index = 0; index < M * M; ++index)
+		Grid[index] *= Kernel[index] * factor;
+
+	fft2d(Grid, M, 1);
+
+	// Interpolating the accelerations back, with the same weights:
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(PM_THREADS)
+	#endif
+	for (int k = 0; k < number; ++k)
+	{
+		BodyState *state = states[k];
+
+		if (state == NULL)
+			continue;
+
+		int i, j;
+		double fx, fy;
+		cellWeights((state -> PosX - x0) / h, (state -> PosY - y0) / h, &i, &j, &fx, &fy);
+
+		double complex a = Grid[(size_t) j * M + i] * (1. - fx) * (1. - fy) + Grid[(size_t) j * M + i + 1] * fx * (1. - fy)
+			+ Grid[(size_t) (j + 1) * M + i] * (1. - fx) * fy + Grid[(size_t) (j + 1) * M + i + 1] * fx * fy;
+
+		state -> AccelX = creal(a);
+		state -> AccelY = cimag(a);
+	}
+}
+
+
+// Compares the PM accelerations of the given bodies to the direct sum, and prints the relative errors and timings.
+void validatePM(Body **bodies, int bodies_number)
+{
+	BodyState **states = (BodyState**) calloc(bodies_number, sizeof(BodyState*));
+	double *ax = (double*) calloc(bodies_number, sizeof(double));
+	double *ay = (double*) calloc(bodies_number, sizeof(double));
+
+	if (states == NULL || ax == NULL || ay == NULL)
+	{
+		printf("\nNot enough memory for the PM validation.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < bodies_number; ++i)
+		states[i] = bodies[i] == NULL ? NULL : bodies[i] -> State;
+
+	double start = realTime();
+
+	directAccelerations(states, bodies_number, ax, ay);
+
+	double direct_time = realTime() - start;
+
+	start = realTime();
+
+	computeAccelerationsPM(states, bodies_number);
+
+	double pm_time = realTime() - start;
+
+	double rms_error, max_error;
+	accelerationErrors(states, bodies_number, ax, ay, &rms_error, &max_error);
+
+	printf("PM validation, %d bodies, grid %d: relative error rms %.2e, max %.2e. PM: %.2f ms, direct sum: %.2f ms\n\n",
+		bodies_number, N, rms_error, max_error, 1000. * pm_time, 1000. * direct_time);
+
+	free(states);
+	free(ax);
+	free(ay);
+}
+
+
+// To be done upon exit.
+void freePMResources(void)
+{
+	free(Kernel);
+	free(Grid);
+	free(Deposits);
+
+	Kernel = NULL;
+	Grid = NULL;
+	Deposits = NULL;
+
+	freeFFTResources();
+}
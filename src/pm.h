@@ -0,0 +1,23 @@
+#ifndef PM_H
+#define PM_H
+
+
+#include "bodies.h"
+
+
+// Particle-mesh (PM) gravity: masses are assigned to a PM_GRID_SIZE x PM_GRID_SIZE grid covering the bodies
+// with the cloud-in-cell scheme, the accelerations on the grid are obtained by FFT convolution with the
+// gravity kernel, zero padding giving isolated boundaries, and are interpolated back to the bodies.
+// Forces are therefore smoothed at the scale of a grid cell. NULL states are skipped, accelerations are overwritten.
+void computeAccelerationsPM(BodyState **states, int number);
+
+
+// Compares the PM accelerations of the given bodies to the direct sum, and prints the relative errors and timings.
+void validatePM(Body **bodies, int bodies_number);
+
+
+// To be done upon exit.
+void freePMResources(void);
+
+
+#endif
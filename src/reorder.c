@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "settings.h"
+#include "reorder.h"
+#include "trails.h"
+#include "frames.h"
+
+
+#ifdef ENABLE_MULTITHREADING
+	#define SORT_THREADS THREAD_NUMBER
+#else
+	#define SORT_THREADS 1
+#endif
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+#define COORDINATE_BITS 16 // Per axis, keys being 32 bits long.
+
+
+// Keys and indexes being sorted, and the buffers used by the radix sort passes:
+static Uint32 *Keys = NULL;
+static Uint32 *TempKeys = NULL;
+static int *Order = NULL;
+static int *TempOrder = NULL;
+static Body **Sorted = NULL;
+static int Capacity = 0;
+
+static int Counts[SORT_THREADS][RADIX_SIZE];
+
+static int FramesSinceReorder = 0;
+
+
+static void reserveBuffers(int bodies_number)
+{
+	if (bodies_number <= Capacity)
+		return;
+
+	freeReorderResources();
+
+	Keys = (Uint32*) calloc(bodies_number, sizeof(Uint32));
+	TempKeys = (Uint32*) calloc(bodies_number, sizeof(Uint32));
+	Order = (int*) calloc(bodies_number, sizeof(int));
+	TempOrder = (int*) calloc(bodies_number, sizeof(int));
+	Sorted = (Body**) calloc(bodies_number, sizeof(Body*));
+
+	if (Keys == NULL || TempKeys == NULL || Order == NULL || TempOrder == NULL || Sorted == NULL)
+	{
+		printf("\nNot enough memory to reorder the bodies.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Capacity = bodies_number;
+}
+
+
+// Spreads the 16 lower bits of x over the even bits:
+static Uint32 spreadBits(Uint32 x)
+{
+	x &= 0xffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+
+	return x;
+}
+
+
+// Morton key of each body, coordinates being quantized over the bounding box of all bodies:
+static void computeKeys(Body **bodies, int bodies_number)
+{
+	double x, y;
+
+	getAbsolutePosition(bodies[0], &x, &y);
+
+	double xmin = x, xmax = xmin;
+	double ymin = y, ymax = ymin;
+
+	for (int i = 1; i < bodies_number; ++i)
+	{
+		getAbsolutePosition(bodies[i], &x, &y);
+
+		xmin = MIN(xmin, x);
+		xmax = MAX(xmax, x);
+		ymin = MIN(ymin, y);
+		ymax = MAX(ymax, y);
+	}
+
+	const double max_coordinate = (1 << COORDINATE_BITS) - 1;
+
+	double x_factor = xmax > xmin ? max_coordinate / (xmax - xmin) : 0.;
+	double y_factor = ymax > ymin ? max_coordinate / (ymax - ymin) : 0.;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		getAbsolutePosition(bodies[i], &x, &y);
+
+		Uint32 key_x = (x - xmin) * x_factor;
+		Uint32 key_y = (y - ymin) * y_factor;
+
+		Keys[i] = spreadBits(key_x) | (spreadBits(key_y) << 1);
+		Order[i] = i;
+	}
+}
+
+
+// Stable LSD radix sort of the keys, along with the bodies indexes. Each thread counts the digits
+// of its own chunk, then scatters it at offsets computed from all the counts:
+static void radixSort(int number)
+{
+	for (int shift = 0; shift < 32; shift += RADIX_BITS)
+	{
+		#ifdef ENABLE_MULTITHREADING
+			#pragma omp parallel for num_threads(SORT_THREADS)
+		#endif
+		for (int t = 0; t < SORT_THREADS; ++t)
+		{
+			int begin = (long) number * t / SORT_THREADS, end = (long) number * (t + 1) / SORT_THREADS;
+
+			memset(Counts[t], 0, sizeof(Counts[t]));
+
+			for (int i = begin; i < end; ++i)
+				++Counts[t][(Keys[i] >> shift) & (RADIX_SIZE - 1)];
+		}
+
+		// Offsets, digit-major then thread-minor for the sort to be stable:
+
+		int sum = 0;
+
+		for (int digit = 0; digit < RADIX_SIZE; ++digit)
+		{
+			for (int t = 0; t < SORT_THREADS; ++t)
+			{
+				int count = Counts[t][digit];
+				Counts[t][digit] = sum;
+				sum += count;
+			}
+		}
+
+		#ifdef ENABLE_MULTITHREADING
+			#pragma omp parallel for num_threads(SORT_THREADS)
+		#endif
+		for (int t = 0; t < SORT_THREADS; ++t)
+		{
+			int begin = (long) number * t / SORT_THREADS, end = (long) number * (t + 1) / SORT_THREADS;
+
+			for (int i = begin; i < end; ++i)
+			{
+				int position = Counts[t][(Keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+
+				TempKeys[position] = Keys[i];
+				TempOrder[position] = Order[i];
+			}
+		}
+
+		// 4 passes, the result ends up in the original buffers:
+
+		Uint32 *keys = Keys;
+		Keys = TempKeys;
+		TempKeys = keys;
+
+		int *order = Order;
+		Order = TempOrder;
+		TempOrder = order;
+	}
+}
+
+
+// Sorts the bodies along a Morton curve, so that bodies close in space are close in the bodies array
+// and in memory. Trails follow their bodies. Any Body pointer is invalidated, handles stay valid.
+// The bodies array must have been compacted.
+void reorderBodies(Body **bodies, int bodies_number)
+{
+	if (bodies_number < 2)
+		return;
+
+	reserveBuffers(bodies_number);
+
+	computeKeys(bodies, bodies_number);
+
+	radixSort(bodies_number);
+
+	for (int k = 0; k < bodies_number; ++k)
+		Sorted[k] = bodies[Order[k]];
+
+	memcpy(bodies, Sorted, bodies_number * sizeof(Body*));
+
+	permuteTrails(Order, bodies_number);
+
+	// Bodies contents are moved in the arena to follow the new order:
+	arrangeBodies(bodies, bodies_number);
+}
+
+
+// To be called once per frame. Reorders the bodies every REORDER_PERIOD frames, or sooner after collisions.
+void updateBodiesOrder(Body **bodies, int bodies_number, int collided)
+{
+	if (REORDER_PERIOD <= 0 || DETERMINISTIC || bodies_number < REORDER_MIN_BODIES)
+		return;
+
+	++FramesSinceReorder;
+
+	if (FramesSinceReorder >= REORDER_PERIOD || (collided && FramesSinceReorder >= REORDER_PERIOD / 10))
+	{
+		reorderBodies(bodies, bodies_number);
+
+		FramesSinceReorder = 0;
+	}
+}
+
+
+// To be done upon exit.
+void freeReorderResources(void)
+{
+	free(Keys);
+	free(TempKeys);
+	free(Order);
+	free(TempOrder);
+	free(Sorted);
+
+	Keys = TempKeys = NULL;
+	Order = TempOrder = NULL;
+	Sorted = NULL;
+
+	Capacity = 0;
+}
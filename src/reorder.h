@@ -0,0 +1,22 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+
+#include "bodies.h"
+
+
+// Sorts the bodies along a Morton curve, so that bodies close in space are close in the bodies array
+// and in memory. Trails follow their bodies. Any Body pointer is invalidated, handles stay valid.
+// The bodies array must have been compacted.
+void reorderBodies(Body **bodies, int bodies_number);
+
+
+// To be called once per frame. Reorders the bodies every REORDER_PERIOD frames, or sooner after collisions.
+void updateBodiesOrder(Body **bodies, int bodies_number, int collided);
+
+
+// To be done upon exit.
+void freeReorderResources(void);
+
+
+#endif
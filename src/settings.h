@@ -30,6 +30,18 @@
 
 #define FRAMERATE 60
 
+#define DRAWING_INTERPOLATION 1 // '0': bodies are drawn as left by the last physics step. '1': interpolated between
+// the two last physics states, smooth but one physics step late. '2': extrapolated from the last state with
+// the bodies speed, without latency but overshooting a bit on sharp turns.
+
+#define USE_VSYNC 0 // '1': frames are paced by the display refresh rate, if supported, instead of by FRAMERATE.
+
+#define INPUT_IDLE_TIMEOUT 1000 // In ms. When paused with nothing to redraw, the program sleeps until an input comes,
+// or at most this long.
+
+#define PACING_SPIN_TIME 1e-3 // In seconds. Time busy-waited before each frame deadline, instead of sleeping,
+// for the frame rate to be precise.
+
 
 ///////////////////////////////////////////////////////////////
 // Simulation settings:
@@ -40,9 +52,26 @@
 
 #define TIME_SCALE_MULTIPLIER 1.25 // For slowing down / speeding up the simulation.
 
+#define PHYSICS_RATE FRAMERATE // Physics steps per second, when DRAWING_INTERPOLATION != 0. It may then differ from
+// the display frame rate: several steps, or none, are done per displayed frame.
+
+#define MAX_STEPS_PER_FRAME 4 // When physics can't keep up, the simulation slows down instead of never catching up.
+
+#define INTEGRATOR 0 // '0': generic integrator, with UPDATES_PER_FRAME substeps per frame. '1': Wisdom-Holman symplectic map,
+// for systems dominated by a central body: orbits around it are solved exactly, and only perturbed by the other bodies,
+// so that far larger steps are stable. Their gravity is computed by direct sum, whatever GRAVITY_SOLVER.
+#define WH_STEPS_PER_FRAME 1 // Steps per frame of the Wisdom-Holman map.
+
 #define UPDATES_PER_FRAME 50 // Number of updates per frame. The larger the value, the more precise the simulation,
 // but this has an impact on performance.
 
+// '1': the number of substeps per frame is chosen for the error estimate of a substep, i.e. the relative speed error
+// of the fastest changing body, to stay below ADAPTIVE_TOLERANCE. UPDATES_PER_FRAME is then the initial value:
+#define ADAPTIVE_SUBSTEPS 0
+#define ADAPTIVE_TOLERANCE 1e-6
+#define ADAPTIVE_MIN_SUBSTEPS 1
+#define ADAPTIVE_MAX_SUBSTEPS 2000
+
 #define ENABLE_MULTITHREADING // Multithreading can improve performances when working with a large number of bodies.
 // However, it can also be greatly better to disable it when the number of bodies is small and UPDATES_PER_FRAME is large.
 // It may be useful to try different settings, by setting BENCHMARK_SIMULATION to 1.
@@ -50,6 +79,90 @@
 #define THREAD_NUMBER 3 // Use a small value. For the machine this has been developed on,
 // 3 works best, 2 also helps a bit. But things get worst up to 4...
 
+#define SMALL_SYSTEM_KERNELS 1 // '1': systems of at most 8 bodies are moved by kernels specialized for their numbers of
+// bodies, unrolled and single-threaded, the loops and threads overhead dominating for so few bodies. Same results.
+
+// When frames take too long, the governor lowers the simulation quality instead of letting the simulation slow down.
+// In that order: fewer substeps per frame, accelerations reused over several substeps, and rendering skipped frames.
+#define ENABLE_GOVERNOR 1
+#define GOVERNOR_BUDGET 0.85 // Fraction of the frame time physics and drawing may take.
+#define GOVERNOR_MIN_SUBSTEPS 10
+#define GOVERNOR_MAX_FORCE_INTERVAL 4
+#define GOVERNOR_MAX_RENDER_INTERVAL 6
+#define GOVERNOR_PERIOD 15 // In frames. Decisions are only taken at this rate, to avoid oscillations.
+
+#define TURBO_DRAW_RATE 10 // In fast-forward mode, times per second the scene is drawn and inputs are polled.
+
+// With many bodies, those are sorted along a space-filling curve every REORDER_PERIOD frames, or sooner after
+// collisions, for bodies close in space to be close in memory. '0' disables it:
+#define REORDER_PERIOD 300
+#define REORDER_MIN_BODIES 1024
+
+#define BODY_ARENA_BLOCK_SIZE 1024 // Bodies are allocated by blocks of this many bodies.
+
+// Deterministic mode: trajectories are bitwise identical from one run to the next, whatever the number of threads,
+// for the same inputs. Random simulations use a fixed seed, the physics rate doesn't depend on the display, and
+// neither the governor nor the bodies reordering are used, their decisions depending on timings. Every
+// DETERMINISTIC_HASH_PERIOD physics steps, a hash of the bodies states is printed, for runs to be compared:
+#define DETERMINISTIC 0
+#define DETERMINISTIC_SEED 42
+#define DETERMINISTIC_HASH_PERIOD 600
+#define DETERMINISTIC_PARTS 8 // Fixed number of partial sums in parallel reductions, whatever the threads number.
+
+#define GRAVITY_SOLVER 0 // '0': direct sum, exact but quadratic in the number of bodies. '1': particle-mesh (PM),
+// for very large numbers of bodies. Forces are then smoothed at the scale of a grid cell. '2': fast multipole
+// method (FMM), linear in the number of bodies, its accuracy being set by FMM_ORDER. Collisions are ignored by both.
+#define PM_GRID_SIZE 256 // Must be a power of 2. Grids of twice this size are used, for isolated boundaries.
+#define FMM_ORDER 10 // Order of the multipole expansions.
+#define FMM_LEAF_SIZE 64 // Mean number of bodies per leaf cell of the FMM tree, for uniformly spread bodies.
+#define SOLVER_VALIDATION 1 // '1': at startup, approximate forces are compared to the direct sum, with few enough bodies.
+#define SOLVER_VALIDATION_MAX_BODIES 5000
+
+// Bodies of mass up to TEST_PARTICLE_MAX_MASS (in kg) are test particles: they feel the gravity of massive bodies,
+// but neither perturb them nor each other, which costs the number of massive bodies times the number of test particles.
+// With the direct sum, they are integrated with TEST_PARTICLE_SUBSTEPS substeps per frame at most, in blocks of
+// TEST_PARTICLE_BLOCK particles (vectorized), split between TEST_PARTICLE_THREADS threads:
+#define TEST_PARTICLE_MAX_MASS 1e12
+#define TEST_PARTICLE_SUBSTEPS 0 // '0': as many as massive bodies. Lower values are way cheaper with many
+// test particles, but less precise for the ones close to massive bodies.
+#define TEST_PARTICLE_BLOCK 8
+#define MIXED_PRECISION 0 // '1': the gravity terms on test particles are computed in single precision, and summed
+// with compensation. Up to twice faster with many massive bodies, for relative errors around 1e-7, larger where
+// forces cancel out. Errors and throughputs are printed at startup when SOLVER_VALIDATION is set.
+#define TEST_PARTICLE_THREADS THREAD_NUMBER
+
+// Ephemeris mode: the trajectories of the massive bodies are precomputed at startup over EPHEMERIS_DAYS days,
+// by the physics engine without collisions, and saved in EPHEMERIS_FILE for the next runs. Only test particles,
+// e.g. the ship, are then integrated, against positions interpolated by Chebyshev series of degree EPHEMERIS_DEGREE,
+// each covering EPHEMERIS_SEGMENT_STEPS physics steps. Past that duration, every body is integrated again.
+#define EPHEMERIS_MODE 0 // '1' to enable it.
+#define EPHEMERIS_FILE "ephemeris.bin"
+#define EPHEMERIS_DAYS 365.25
+#define EPHEMERIS_SEGMENT_STEPS 60
+#define EPHEMERIS_DEGREE 12
+
+#define RING_PARTICLES_NUMBER 1000000 // Test particles of the ring simulation.
+
+#define DISK_BODIES_NUMBER 100000 // Bodies of the disk simulation, when using the PM or FMM solvers.
+
+#define CONTINUOUS_COLLISIONS 1 // '1': collisions between massive bodies are also looked for in between steps,
+// from their relative motion, for fast bodies not to pass through each other with large time steps. They then merge
+// at their time and place of contact. '2': test particles too, which slows their integration down by about 30%.
+// Only with the direct sum and the generic integrator.
+
+#define REFERENCE_FRAMES 0 // '1': positions and speeds are stored relative to a parent body, e.g. a moon relative to
+// its planet, itself relative to its star, for them to keep their precision far from the origin. Every
+// REFERENCE_FRAMES_PERIOD physics steps, each body is given the heavier body of smallest Hill sphere containing it
+// as parent. The camera follows bodies through that hierarchy. Only with the direct sum and the generic integrator.
+#define REFERENCE_FRAMES_PERIOD 60
+
+#define KEPLER_FAST_FORWARD 0 // '1': each physics step, test particles whose acceleration relative to their main
+// attractor differs from its gravity by less than KEPLER_PERTURBATION_THRESHOLD times it, and whose orbit doesn't
+// graze it, are moved along their Kepler orbit in one go instead of being integrated over the substeps. They are
+// integrated again as soon as another body gets close enough to perturb them. Only with the direct sum and the
+// generic integrator.
+#define KEPLER_PERTURBATION_THRESHOLD 1e-4
+
 #define CHEAT 0 // '1': allows lower values of 'UPDATES_PER_FRAME', for unknown reason. '0' otherwise.
 
 #define BENCHMARK_SIMULATION 1 // Used to estimate the time spend on drawing or doing physics computations.
@@ -84,6 +197,25 @@
 
 #define DRAW_COMPASS_ALL_OBJECTS 1
 
+// Bodies names are rendered on demand in a shared atlas, least recently used ones being evicted:
+#define LABEL_ATLAS_COLUMNS 2
+#define LABEL_ATLAS_ROWS 64 // The atlas holds at most LABEL_ATLAS_COLUMNS * LABEL_ATLAS_ROWS names.
+#define LABEL_SLOT_WIDTH 512 // Longer names are clipped.
+#define LABEL_NEW_PER_FRAME 16 // Maximum number of names added to the atlas per frame, to avoid spikes.
+#define LABEL_CELL_SIZE 8 // Size in pixels of the cells used for culling overlapping names.
+
+// Orbit trails. The last TRAIL_LENGTH positions of each body are stored, one every TRAIL_SAMPLE_TIME
+// seconds of simulation at most. With many bodies, trails get shorter so that TRAIL_MAX_POINTS is never exceeded:
+#define TRAIL_LENGTH 256
+#define TRAIL_SAMPLE_TIME (6. * 3600.)
+#define TRAIL_MAX_POINTS (1 << 20)
+
+// Trails are simplified on-screen: points are kept when the trail turns by more than TRAIL_MAX_ANGLE (in radians),
+// or when the last kept point is further than TRAIL_MAX_PIXELS. Points closer than TRAIL_MIN_PIXELS are dropped:
+#define TRAIL_MAX_ANGLE 0.05
+#define TRAIL_MIN_PIXELS 2.
+#define TRAIL_MAX_PIXELS 50.
+
 
 ///////////////////////////////////////////////////////////////
 // Hotkeys:
@@ -95,6 +227,7 @@
 
 #define TOGGLE_DRAWING_ALL_NAMES SDLK_n
 #define TOGGLE_COLLISIONS_KEY SDLK_c
+#define TOGGLE_TRAILS_KEY SDLK_t
 
 #define CAMERA_UP SDLK_UP
 #define CAMERA_DOWN SDLK_DOWN
@@ -106,6 +239,7 @@
 
 #define SLOW_DOWN_TIME SDLK_1
 #define SPEED_UP_TIME SDLK_2
+#define TOGGLE_TURBO_KEY SDLK_3
 
 #define MOVE_UP_KEY SDLK_z
 #define MOVE_DOWN_KEY SDLK_s
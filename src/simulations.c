@@ -1,27 +1,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <math.h>
 
 #include "simulations.h"
 #include "physics.h"
+#include "trails.h"
 
 
-#ifndef _WIN32
-#include <sys/time.h>
-double realTime(void)
+// Monotonic clock, in ns:
+Uint64 realTimeNs(void)
 {
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.;
+	static Uint64 frequency = 0;
+
+	if (frequency == 0)
+		frequency = SDL_GetPerformanceFrequency();
+
+	Uint64 counter = SDL_GetPerformanceCounter();
+
+	// Avoiding an overflow of counter * 1e9:
+	return (counter / frequency) * 1000000000ull + (counter % frequency) * 1000000000ull / frequency;
 }
 
-#else
-#include <windows.h> // to be replaced!
+
+// Monotonic clock, in seconds:
 double realTime(void)
 {
-	return (double) GetTickCount() / 1000.;
+	return realTimeNs() / 1e9;
 }
-#endif
 
 
 double unif_rand(double min, double max)
@@ -30,48 +36,29 @@ double unif_rand(double min, double max)
 }
 
 
-// Removes NULL bodies from the body array, modifies
-// the number of bodies, and updates 'IndexFollowedBody'.
-void refreshBodyArray(Body ***oldArray, int *oldLength)
+// Removes NULL bodies from the body array, in place, modifies the number of bodies and updates the trails.
+// Bodies themselves don't move, and are referenced by handles anyway.
+void refreshBodyArray(Body **bodies, int *bodies_number)
 {
-	int old_length = *oldLength, new_length = 0;
-
-	for (int i = 0; i < old_length; ++i)
-		new_length += (*oldArray)[i] != NULL;
-
-	if (new_length == old_length)
-		return;
-
-	// Creating a new array:
-
-	*oldLength = new_length;
-
-	Body **newArray = (Body**) calloc(new_length, sizeof(Body*));
-
-	if (newArray == NULL)
-	{
-		printf("\nNot enough memory to create a new bodies array.\n");
-		exit(EXIT_FAILURE);
-	}
-
 	int index = 0;
 
-	for (int i = 0; i < old_length; ++i)
+	for (int i = 0; i < *bodies_number; ++i)
 	{
-		if ((*oldArray)[i] != NULL)
+		if (bodies[i] != NULL)
 		{
-			if (i == IndexFollowedBody)
-				IndexFollowedBody = index;
+			if (i != index)
+			{
+				moveTrail(i, index);
 
-			newArray[index] = (*oldArray)[i];
+				bodies[index] = bodies[i];
+				bodies[i] = NULL;
+			}
 
 			++index;
 		}
 	}
 
-	free(*oldArray);
-
-	*oldArray = newArray;
+	*bodies_number = index;
 }
 
 
@@ -175,3 +162,101 @@ Body** simul_manyBodies(int *bodies_number, Body **ship)
 
 	return bodies;
 }
+
+
+
+// A star, its planets and a ring of many test particles, i.e. massless bodies.
+Body** simul_ring(int *bodies_number, Body **ship)
+{
+	const double au = 1.496e11; // Astronomical unit, in m.
+	const double star_mass = 1.989e30;
+
+	const double planets_distance[] = {0.39 * au, 0.72 * au, 1. * au, 1.52 * au};
+	const double planets_radius[] = {2.44e6, 6.05e6, 6.37e6, 3.39e6};
+	const double planets_mass[] = {3.30e23, 4.87e24, 5.97e24, 6.42e23};
+
+	const int planets_number = 4;
+
+	*bodies_number = 1 + planets_number + RING_PARTICLES_NUMBER;
+
+	printf("\nNumber of bodies: %d\n", *bodies_number);
+
+	Body **bodies = (Body**) calloc(*bodies_number, sizeof(Body*));
+
+	if (bodies == NULL)
+	{
+		printf("\nNot enough memory to store all the bodies.\n\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bodies[0] = createBody("Sun", Star, 6.96e8, star_mass, 0, 0, 0, 0);
+
+	char name_string[20];
+
+	for (int i = 0; i < *bodies_number - 1; ++i)
+	{
+		int planet = i < planets_number;
+
+		// Ring particles are spread between 2.2 and 3.2 au, like the asteroid belt:
+		double r = planet ? planets_distance[i] : unif_rand(2.2 * au, 3.2 * au);
+		double angle = unif_rand(0., 2. * 3.14159265358979323846);
+		double speed = sqrt(GravitationalConst * star_mass / r);
+
+		if (planet)
+			sprintf(name_string, "Planet_%d", i);
+		else
+			sprintf(name_string, "Particle_%d", i - planets_number);
+
+		bodies[i + 1] = createBody(name_string, planet ? Planet : Asteroid, planet ? planets_radius[i] : 1e3,
+			planet ? planets_mass[i] : 0., r * cos(angle), r * sin(angle), -speed * sin(angle), speed * cos(angle));
+	}
+
+	*ship = NULL;
+
+	return bodies;
+}
+
+// A star and a disk of light bodies on circular orbits. Many bodies are created when using the PM or FMM solvers.
+Body** simul_disk(int *bodies_number, Body **ship)
+{
+	double star_mass = 1e27;
+	double star_radius = 7e7;
+	double particle_mass = 1e18;
+	double particle_radius = 1e5;
+	double inner_radius = 1.5e8;
+	double outer_radius = 5e8;
+
+	// The direct sum is way too slow for that many bodies:
+	*bodies_number = GRAVITY_SOLVER != 0 ? DISK_BODIES_NUMBER : MIN(DISK_BODIES_NUMBER, 2000);
+
+	printf("\nNumber of bodies: %d\n", *bodies_number);
+
+	Body **bodies = (Body**) calloc(*bodies_number, sizeof(Body*));
+
+	if (bodies == NULL)
+	{
+		printf("\nNot enough memory to store all the bodies.\n\n");
+		exit(EXIT_FAILURE);
+	}
+
+	bodies[0] = createBody("Star", Star, star_radius, star_mass, 0, 0, 0, 0);
+
+	char name_string[20];
+
+	for (int i = 1; i < *bodies_number; ++i)
+	{
+		sprintf(name_string, "Particle_%d", i);
+
+		// Uniform surface density:
+		double r = sqrt(unif_rand(inner_radius * inner_radius, outer_radius * outer_radius));
+		double angle = unif_rand(0., 2. * 3.14159265358979323846);
+		double speed = sqrt(GravitationalConst * star_mass / r);
+
+		bodies[i] = createBody(name_string, Asteroid, particle_radius, particle_mass,
+			r * cos(angle), r * sin(angle), -speed * sin(angle), speed * cos(angle));
+	}
+
+	*ship = NULL;
+
+	return bodies;
+}
@@ -6,18 +6,22 @@
 
 
 extern int Quit;
-extern int IndexFollowedBody;
 
 
+// Monotonic clock, in ns:
+Uint64 realTimeNs(void);
+
+
+// Monotonic clock, in seconds:
 double realTime(void);
 
 
 double unif_rand(double min, double max);
 
 
-// Removes NULL bodies from the body array, modifies
-// the number of bodies, and updates 'indexFollowedBody'.
-void refreshBodyArray(Body ***oldArray, int *oldLength);
+// Removes NULL bodies from the body array, in place, modifies the number of bodies and updates the trails.
+// Bodies themselves don't move, and are referenced by handles anyway.
+void refreshBodyArray(Body **bodies, int *bodies_number);
 
 
 // Benchmarking 'UPDATES_PER_FRAME':
@@ -33,4 +37,12 @@ Body** simul_3Earths(int *bodies_number, Body **ship);
 Body** simul_manyBodies(int *bodies_number, Body **ship);
 
 
+// A star, its planets and a ring of many test particles, i.e. massless bodies.
+Body** simul_ring(int *bodies_number, Body **ship);
+
+
+// A star and a disk of light bodies on circular orbits. Many bodies are created when using the PM or FMM solvers.
+Body** simul_disk(int *bodies_number, Body **ship);
+
+
 #endif
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "settings.h"
+#include "symplectic.h"
+#include "kepler.h"
+
+
+// Democratic heliocentric coordinates: positions relative to the central body, and barycentric speeds.
+// Masses are replaced by gravity factors, G being a common factor:
+static double *PosX = NULL, *PosY = NULL, *SpeedX = NULL, *SpeedY = NULL;
+static int Capacity = 0;
+
+
+static void initBuffers(int number)
+{
+	if (number <= Capacity)
+		return;
+
+	freeSymplecticResources();
+
+	PosX = (double*) calloc(number, sizeof(double));
+	PosY = (double*) calloc(number, sizeof(double));
+	SpeedX = (double*) calloc(number, sizeof(double));
+	SpeedY = (double*) calloc(number, sizeof(double));
+
+	if (PosX == NULL || PosY == NULL || SpeedX == NULL || SpeedY == NULL)
+	{
+		printf("\nNot enough memory for the Wisdom-Holman integrator.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Capacity = number;
+}
+
+
+// Interaction kick: every body but the central one is accelerated by the massive ones but the central one.
+// Overlaps are looked for at the same time. The stored accelerations include the central body pull:
+static int interactionKick(BodyState **states, int number, int massive_number, int central, double step, int *hits)
+{
+	double mu = states[central] -> GravityFactor;
+
+	int hits_number = 0;
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(THREAD_NUMBER) schedule(static) reduction(+:hits_number)
+	#endif
+	for (int i = 0; i < number; ++i)
+	{
+		if (states[i] == NULL || i == central)
+			continue;
+
+		double accel_x = 0., accel_y = 0.;
+
+		for (int j = 0; j < massive_number; ++j)
+		{
+			if (states[j] == NULL || j == central || j == i)
+				continue;
+
+			double dx = PosX[j] - PosX[i];
+			double dy = PosY[j] - PosY[i];
+
+			double dist = sqrt(dx * dx + dy * dy);
+
+			if (dist <= states[i] -> Radius + states[j] -> Radius)
+			{
+				hits[i] = j;
+				++hits_number;
+				continue;
+			}
+
+			double factor = states[j] -> GravityFactor / (dist * dist * dist);
+
+			accel_x += factor * dx;
+			accel_y += factor * dy;
+		}
+
+		SpeedX[i] += accel_x * step;
+		SpeedY[i] += accel_y * step;
+
+		double dist = sqrt(PosX[i] * PosX[i] + PosY[i] * PosY[i]);
+		double central_factor = dist == 0. ? 0. : mu / (dist * dist * dist);
+
+		states[i] -> AccelX = accel_x - central_factor * PosX[i];
+		states[i] -> AccelY = accel_y - central_factor * PosY[i];
+	}
+
+	return hits_number;
+}
+
+
+// Linear drift of the heliocentric positions, due to the central body motion:
+static void centralDrift(BodyState **states, int number, int massive_number, int central, double step)
+{
+	double momentum_x = 0., momentum_y = 0.;
+
+	for (int i = 0; i < massive_number; ++i)
+	{
+		if (states[i] == NULL || i == central)
+			continue;
+
+		momentum_x += states[i] -> GravityFactor * SpeedX[i];
+		momentum_y += states[i] -> GravityFactor * SpeedY[i];
+	}
+
+	double shift_x = momentum_x / states[central] -> GravityFactor * step;
+	double shift_y = momentum_y / states[central] -> GravityFactor * step;
+
+	for (int i = 0; i < number; ++i)
+	{
+		if (states[i] == NULL || i == central)
+			continue;
+
+		PosX[i] += shift_x;
+		PosY[i] += shift_y;
+	}
+}
+
+
+// Wisdom-Holman step of 'step' seconds, in democratic heliocentric coordinates: the most massive body is the central one,
+// the others follow Kepler orbits around it, perturbed by kicks from each other and by the motion of the central body.
+// Only the first 'massive_number' states are sources of gravity, the other ones being test particles.
+// Overlapping bodies are not merged here, but reported: hits[i] is the index of a massive state overlapping states[i],
+// -1 if none. Returns the number of overlaps found. NULL states are skipped.
+int stepWisdomHolman(BodyState **states, int number, int massive_number, double step, int *hits)
+{
+	initBuffers(number);
+
+	for (int i = 0; i < number; ++i)
+		hits[i] = -1;
+
+	// Central body and barycenter:
+
+	int central = -1;
+	double total = 0., center_x = 0., center_y = 0., center_speed_x = 0., center_speed_y = 0.;
+
+	for (int i = 0; i < massive_number; ++i)
+	{
+		BodyState *state = states[i];
+
+		if (state == NULL)
+			continue;
+
+		if (central == -1 || state -> GravityFactor > states[central] -> GravityFactor)
+			central = i;
+
+		total += state -> GravityFactor;
+		center_x += state -> GravityFactor * state -> PosX;
+		center_y += state -> GravityFactor * state -> PosY;
+		center_speed_x += state -> GravityFactor * state -> SpeedX;
+		center_speed_y += state -> GravityFactor * state -> SpeedY;
+	}
+
+	if (central == -1 || total == 0.)
+		return 0;
+
+	center_x /= total;
+	center_y /= total;
+	center_speed_x /= total;
+	center_speed_y /= total;
+
+	BodyState *sun = states[central];
+
+	for (int i = 0; i < number; ++i)
+	{
+		if (states[i] == NULL || i == central)
+			continue;
+
+		PosX[i] = states[i] -> PosX - sun -> PosX;
+		PosY[i] = states[i] -> PosY - sun -> PosY;
+		SpeedX[i] = states[i] -> SpeedX - center_speed_x;
+		SpeedY[i] = states[i] -> SpeedY - center_speed_y;
+	}
+
+	// Kick, drift, Kepler, drift, kick:
+
+	int hits_number = interactionKick(states, number, massive_number, central, step / 2., hits);
+
+	centralDrift(states, number, massive_number, central, step / 2.);
+
+	double mu = sun -> GravityFactor;
+
+	#ifdef ENABLE_MULTITHREADING
+		#pragma omp parallel for num_threads(THREAD_NUMBER) schedule(dynamic, 256) reduction(+:hits_number)
+	#endif
+	for (int i = 0; i < number; ++i)
+	{
+		if (states[i] == NULL || i == central)
+			continue;
+
+		keplerDrift(mu, PosX + i, PosY + i, SpeedX + i, SpeedY + i, step);
+
+		if (sqrt(PosX[i] * PosX[i] + PosY[i] * PosY[i]) <= sun -> Radius + states[i] -> Radius && hits[i] == -1)
+		{
+			hits[i] = central;
+			++hits_number;
+		}
+	}
+
+	centralDrift(states, number, massive_number, central, step / 2.);
+
+	hits_number += interactionKick(states, number, massive_number, central, step / 2., hits);
+
+	// Back to the absolute coordinates, the barycenter moving uniformly:
+
+	center_x += center_speed_x * step;
+	center_y += center_speed_y * step;
+
+	double sum_x = 0., sum_y = 0., sum_speed_x = 0., sum_speed_y = 0., accel_x = 0., accel_y = 0.;
+
+	for (int i = 0; i < massive_number; ++i)
+	{
+		if (states[i] == NULL || i == central)
+			continue;
+
+		double gravity = states[i] -> GravityFactor;
+
+		sum_x += gravity * PosX[i];
+		sum_y += gravity * PosY[i];
+		sum_speed_x += gravity * SpeedX[i];
+		sum_speed_y += gravity * SpeedY[i];
+
+		double dist = sqrt(PosX[i] * PosX[i] + PosY[i] * PosY[i]);
+
+		if (dist > 0.)
+		{
+			accel_x += gravity * PosX[i] / (dist * dist * dist);
+			accel_y += gravity * PosY[i] / (dist * dist * dist);
+		}
+	}
+
+	sun -> PosX = center_x - sum_x / total;
+	sun -> PosY = center_y - sum_y / total;
+	sun -> SpeedX = center_speed_x - sum_speed_x / sun -> GravityFactor;
+	sun -> SpeedY = center_speed_y - sum_speed_y / sun -> GravityFactor;
+	sun -> AccelX = accel_x;
+	sun -> AccelY = accel_y;
+
+	for (int i = 0; i < number; ++i)
+	{
+		if (states[i] == NULL || i == central)
+			continue;
+
+		states[i] -> PosX = sun -> PosX + PosX[i];
+		states[i] -> PosY = sun -> PosY + PosY[i];
+		states[i] -> SpeedX = center_speed_x + SpeedX[i];
+		states[i] -> SpeedY = center_speed_y + SpeedY[i];
+	}
+
+	return hits_number;
+}
+
+
+// To be done upon exit.
+void freeSymplecticResources(void)
+{
+	free(PosX);
+	free(PosY);
+	free(SpeedX);
+	free(SpeedY);
+
+	PosX = NULL;
+	PosY = NULL;
+	SpeedX = NULL;
+	SpeedY = NULL;
+
+	Capacity = 0;
+}
@@ -0,0 +1,20 @@
+#ifndef SYMPLECTIC_H
+#define SYMPLECTIC_H
+
+
+#include "bodies.h"
+
+
+// Wisdom-Holman step of 'step' seconds, in democratic heliocentric coordinates: the most massive body is the central one,
+// the others follow Kepler orbits around it, perturbed by kicks from each other and by the motion of the central body.
+// Only the first 'massive_number' states are sources of gravity, the other ones being test particles.
+// Overlapping bodies are not merged here, but reported: hits[i] is the index of a massive state overlapping states[i],
+// -1 if none. Returns the number of overlaps found. NULL states are skipped.
+int stepWisdomHolman(BodyState **states, int number, int massive_number, double step, int *hits);
+
+
+// To be done upon exit.
+void freeSymplecticResources(void);
+
+
+#endif
@@ -0,0 +1,371 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "settings.h"
+#include "trails.h"
+#include "camera.h"
+#include "physics.h"
+#include "frames.h"
+
+
+#define MAX_COORDINATE 1e7 // On-screen coordinates are clamped, for them to be representable as floats.
+
+
+// ScreenPoint is not available in old SDL versions:
+typedef struct
+{
+	float x;
+	float y;
+} ScreenPoint;
+
+
+extern const double CenterX;
+extern const double CenterY;
+
+extern SDL_Color Red;
+extern SDL_Color Yellow;
+
+
+// Positions of the last 'Length' samples of each body, the trail of body i being stored
+// in [i * Length, (i + 1) * Length). All trails share the same ring buffer head:
+static double *TrailX = NULL;
+static double *TrailY = NULL;
+static int TrailBodies = 0;
+static int Length = 0;
+static int Head = 0; // Slot of the next sample.
+static int Count = 0; // Number of valid samples.
+static double LastSampleTime = 0.;
+
+// Buffers for drawing:
+static SDL_Vertex *Vertices = NULL;
+static int *Indices = NULL;
+static int SegmentsNumber = 0;
+static int SegmentsCapacity = 0;
+static ScreenPoint *Points = NULL; // Simplified trail of a single body.
+static SDL_Point *IntPoints = NULL; // Same points in integers, for SDL versions without geometry rendering.
+static int *Ages = NULL; // Age of those points, in samples.
+
+
+static void allocateTrails(int bodies_number)
+{
+	freeTrails();
+
+	Length = MIN(TRAIL_LENGTH, TRAIL_MAX_POINTS / MAX(bodies_number, 1));
+
+	if (Length < 2)
+	{
+		printf("Too many bodies for drawing trails.\n");
+		Length = 0;
+		TrailBodies = bodies_number; // Not retried until the number of bodies grows.
+		return;
+	}
+
+	TrailX = (double*) calloc((size_t) bodies_number * Length, sizeof(double));
+	TrailY = (double*) calloc((size_t) bodies_number * Length, sizeof(double));
+	Points = (ScreenPoint*) calloc(Length + 1, sizeof(ScreenPoint));
+	IntPoints = (SDL_Point*) calloc(Length + 1, sizeof(SDL_Point));
+	Ages = (int*) calloc(Length + 1, sizeof(int));
+
+	if (TrailX == NULL || TrailY == NULL || Points == NULL || IntPoints == NULL || Ages == NULL)
+	{
+		printf("\nNot enough memory to store the trails.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	TrailBodies = bodies_number;
+}
+
+
+// Records the bodies positions, if at least TRAIL_SAMPLE_TIME seconds of simulation passed since
+// the last sample. To be called after each physics update. Nothing is done when trails are disabled.
+void sampleTrails(Body **bodies, int bodies_number)
+{
+	if (!DrawTrails)
+		return;
+
+	if (bodies_number > TrailBodies)
+		allocateTrails(bodies_number);
+
+	if (Length == 0)
+		return;
+
+	double time = getSimulationTime();
+
+	if (Count > 0 && time - LastSampleTime < TRAIL_SAMPLE_TIME)
+		return;
+
+	LastSampleTime = time;
+
+	for (int i = 0; i < bodies_number; ++i)
+	{
+		if (bodies[i] == NULL)
+			continue;
+
+		getAbsolutePosition(bodies[i], TrailX + i * Length + Head, TrailY + i * Length + Head);
+	}
+
+	Head = (Head + 1) % Length;
+	Count = MIN(Count + 1, Length);
+}
+
+
+// Moves the trail of the body of index 'from' to the index 'to'. Used when the bodies array is compacted.
+void moveTrail(int from, int to)
+{
+	if (TrailX == NULL || from >= TrailBodies || to >= TrailBodies)
+		return;
+
+	memcpy(TrailX + to * Length, TrailX + from * Length, Length * sizeof(double));
+	memcpy(TrailY + to * Length, TrailY + from * Length, Length * sizeof(double));
+}
+
+
+// Reorders the trails along with the bodies: the trail of index i goes to the index k such that order[k] = i.
+void permuteTrails(const int *order, int bodies_number)
+{
+	if (TrailX == NULL || Count == 0)
+		return;
+
+	if (bodies_number > TrailBodies)
+	{
+		clearTrails();
+		return;
+	}
+
+	int number = bodies_number;
+
+	unsigned char *done = (unsigned char*) calloc(number, sizeof(unsigned char));
+	double *tempX = (double*) calloc(Length, sizeof(double));
+	double *tempY = (double*) calloc(Length, sizeof(double));
+
+	if (done == NULL || tempX == NULL || tempY == NULL)
+	{
+		printf("\nNot enough memory to reorder the trails.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Following each cycle of the permutation, with a single trail kept aside:
+
+	for (int start = 0; start < number; ++start)
+	{
+		if (done[start] || order[start] == start)
+			continue;
+
+		memcpy(tempX, TrailX + start * Length, Length * sizeof(double));
+		memcpy(tempY, TrailY + start * Length, Length * sizeof(double));
+
+		int k = start;
+
+		while (order[k] != start)
+		{
+			moveTrail(order[k], k);
+			done[k] = 1;
+			k = order[k];
+		}
+
+		memcpy(TrailX + k * Length, tempX, Length * sizeof(double));
+		memcpy(TrailY + k * Length, tempY, Length * sizeof(double));
+		done[k] = 1;
+	}
+
+	free(done);
+	free(tempX);
+	free(tempY);
+}
+
+
+// Forgets every recorded position.
+void clearTrails(void)
+{
+	Head = 0;
+	Count = 0;
+}
+
+
+// Adds a segment of one pixel wide to the batch, fading from 'alpha0' to 'alpha1':
+static void batchSegment(ScreenPoint *p0, ScreenPoint *p1, SDL_Color color, Uint8 alpha0, Uint8 alpha1)
+{
+	if (SegmentsNumber == SegmentsCapacity)
+	{
+		int capacity = MAX(1024, 2 * SegmentsCapacity);
+
+		SDL_Vertex *vertices = (SDL_Vertex*) realloc(Vertices, 4 * capacity * sizeof(SDL_Vertex));
+		int *indices = (int*) realloc(Indices, 6 * capacity * sizeof(int));
+
+		if (vertices == NULL || indices == NULL)
+		{
+			printf("\nNot enough memory to draw the trails.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		Vertices = vertices;
+		Indices = indices;
+		SegmentsCapacity = capacity;
+	}
+
+	float dx = p1 -> x - p0 -> x, dy = p1 -> y - p0 -> y;
+	float norm = 0.5f / sqrtf(dx * dx + dy * dy); // Segments have a non zero length.
+	float nx = -dy * norm, ny = dx * norm;
+
+	SDL_Color color0 = color, color1 = color;
+	color0.a = alpha0;
+	color1.a = alpha1;
+
+	int first = 4 * SegmentsNumber;
+
+	SDL_Vertex *vertex = Vertices + first;
+
+	vertex[0] = (SDL_Vertex) {{p0 -> x + nx, p0 -> y + ny}, color0, {0.f, 0.f}};
+	vertex[1] = (SDL_Vertex) {{p0 -> x - nx, p0 -> y - ny}, color0, {0.f, 0.f}};
+	vertex[2] = (SDL_Vertex) {{p1 -> x - nx, p1 -> y - ny}, color1, {0.f, 0.f}};
+	vertex[3] = (SDL_Vertex) {{p1 -> x + nx, p1 -> y + ny}, color1, {0.f, 0.f}};
+
+	int *index = Indices + 6 * SegmentsNumber;
+
+	index[0] = first;
+	index[1] = first + 1;
+	index[2] = first + 2;
+	index[3] = first;
+	index[4] = first + 2;
+	index[5] = first + 3;
+
+	++SegmentsNumber;
+}
+
+
+static ScreenPoint toScreen(double x, double y, double scale, double x_origin, double y_origin)
+{
+	x = CenterX + scale * (x - x_origin);
+	y = CenterY + scale * (y - y_origin);
+
+	ScreenPoint point = {fmin(fmax(x, -MAX_COORDINATE), MAX_COORDINATE), fmin(fmax(y, -MAX_COORDINATE), MAX_COORDINATE)};
+
+	return point;
+}
+
+
+// Simplifies the trail of the given body, from its current position to its oldest sample. Points are only kept
+// where the trail turns, so that the number of drawn segments depends on the trail shape on-screen, and not
+// on the time scale. Returns the number of kept points, stored in 'Points', and their ages in 'Ages'.
+static int simplifyTrail(Body *body, int index, double scale, double x_origin, double y_origin)
+{
+	const double cos_max_angle = cos(TRAIL_MAX_ANGLE);
+
+	double *trailX = TrailX + index * Length, *trailY = TrailY + index * Length;
+
+	double x, y;
+	getDrawnPosition(body, &x, &y);
+
+	Points[0] = toScreen(x, y, scale, x_origin, y_origin);
+	Ages[0] = 0;
+
+	int kept = 1, has_direction = 0;
+	float dirX = 0.f, dirY = 0.f;
+
+	for (int age = 1; age <= Count; ++age)
+	{
+		int slot = (Head - age + Length) % Length;
+
+		ScreenPoint point = toScreen(trailX[slot], trailY[slot], scale, x_origin, y_origin);
+
+		float dx = point.x - Points[kept - 1].x, dy = point.y - Points[kept - 1].y;
+		float dist = sqrtf(dx * dx + dy * dy);
+
+		if (dist < TRAIL_MIN_PIXELS)
+			continue;
+
+		int turning = has_direction && (dx * dirX + dy * dirY) < cos_max_angle * dist;
+
+		if (turning || dist >= TRAIL_MAX_PIXELS || age == Count)
+		{
+			Points[kept] = point;
+			Ages[kept] = age;
+			++kept;
+
+			dirX = dx / dist;
+			dirY = dy / dist;
+			has_direction = 1;
+		}
+	}
+
+	return kept;
+}
+
+
+// Draws the trails of every body, with a single batch when supported by the SDL version.
+void drawTrails(Body **bodies, int bodies_number)
+{
+	if (!DrawTrails || Length == 0 || Count == 0)
+		return;
+
+	double scale, x_origin, y_origin;
+
+	getCameraInfo(&scale, &x_origin, &y_origin);
+
+	SegmentsNumber = 0;
+
+	for (int i = 0; i < MIN(bodies_number, TrailBodies); ++i)
+	{
+		if (bodies[i] == NULL)
+			continue;
+
+		SDL_Color color = bodies[i] -> Type == Spaceship ? Red : Yellow;
+
+		int kept = simplifyTrail(bodies[i], i, scale, x_origin, y_origin);
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+		for (int k = 0; k + 1 < kept; ++k)
+		{
+			Uint8 alpha0 = 255 * (Length - Ages[k]) / Length;
+			Uint8 alpha1 = 255 * (Length - Ages[k + 1]) / Length;
+
+			batchSegment(Points + k, Points + k + 1, color, alpha0, alpha1);
+		}
+#else
+		// No fading, one polyline per body:
+
+		for (int k = 0; k < kept; ++k)
+			IntPoints[k] = (SDL_Point) {Points[k].x, Points[k].y};
+
+		SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, 255);
+		SDL_RenderDrawLines(renderer, IntPoints, kept);
+#endif
+	}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	if (SegmentsNumber == 0)
+		return;
+
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+	if (SDL_RenderGeometry(renderer, NULL, Vertices, 4 * SegmentsNumber, Indices, 6 * SegmentsNumber) != 0)
+		SDLA_ExitWithError("Impossible to draw the trails.");
+
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+#endif
+}
+
+
+// To be done upon exit.
+void freeTrails(void)
+{
+	free(TrailX);
+	free(TrailY);
+	free(Points);
+	free(IntPoints);
+	free(Ages);
+	free(Vertices);
+	free(Indices);
+
+	TrailX = TrailY = NULL;
+	Points = NULL;
+	IntPoints = NULL;
+	Ages = NULL;
+	Vertices = NULL;
+	Indices = NULL;
+
+	TrailBodies = Length = Head = Count = 0;
+	SegmentsNumber = SegmentsCapacity = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef TRAILS_H
+#define TRAILS_H
+
+
+#include "bodies.h"
+
+
+extern SDL_Renderer *renderer;
+
+extern int DrawTrails;
+
+
+// Records the bodies positions, if at least TRAIL_SAMPLE_TIME seconds of simulation passed since
+// the last sample. To be called after each physics update. Nothing is done when trails are disabled.
+void sampleTrails(Body **bodies, int bodies_number);
+
+
+// Moves the trail of the body of index 'from' to the index 'to'. Used when the bodies array is compacted.
+void moveTrail(int from, int to);
+
+
+// Reorders the trails along with the bodies: the trail of index i goes to the index k such that order[k] = i.
+void permuteTrails(const int *order, int bodies_number);
+
+
+// Forgets every recorded position.
+void clearTrails(void);
+
+
+// Draws the trails of every body, with a single batch when supported by the SDL version.
+void drawTrails(Body **bodies, int bodies_number);
+
+
+// To be done upon exit.
+void freeTrails(void);
+
+
+#endif
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "settings.h"
+#include "turbo.h"
+#include "physics.h"
+#include "simulations.h"
+#include "trails.h"
+#include "determinism.h"
+
+
+static int TurboOn = 0;
+static double Target = -1.; // Simulation time at which fast-forward stops, negative if none.
+
+static double Rate = 0.; // Simulated seconds per real second, over the last batch.
+
+static Uint64 StartRealTime = 0; // In ns.
+static double StartSimulationTime = 0.;
+
+
+static void startTurbo(void)
+{
+	TurboOn = 1;
+	Rate = 0.;
+
+	StartRealTime = realTimeNs();
+	StartSimulationTime = getSimulationTime();
+
+	printf("Fast-forward started.\n");
+}
+
+
+static void stopTurbo(void)
+{
+	TurboOn = 0;
+	Target = -1.;
+
+	double elapsed = (realTimeNs() - StartRealTime) / 1e9;
+	double simulated = getSimulationTime() - StartSimulationTime;
+
+	printf("Fast-forward stopped: %.2e s simulated in %.2f s, i.e. %.2e simulated s per s.\n",
+		simulated, elapsed, elapsed == 0. ? 0. : simulated / elapsed);
+
+	RenderScene = 1;
+}
+
+
+void toggleTurbo(void)
+{
+	if (TurboOn)
+		stopTurbo();
+	else
+		startTurbo();
+}
+
+
+// Fast-forwards until the given simulation time, in seconds. Fast-forward then stops by itself.
+void setTurboTarget(double simulation_time)
+{
+	if (simulation_time <= getSimulationTime())
+		return;
+
+	Target = simulation_time;
+
+	if (!TurboOn)
+		startTurbo();
+}
+
+
+int isTurboOn(void)
+{
+	return TurboOn;
+}
+
+
+// Runs physics steps back-to-back for 1 / TURBO_DRAW_RATE second of real time, or until the target
+// simulation time is reached. Returns the number of steps done. The ship is looked up before each step,
+// for it may have been absorbed by the previous one.
+int runTurbo(Body **bodies, int bodies_number, BodyHandle ship_handle, Input *input, double thrust)
+{
+	if (!TurboOn)
+		return 0;
+
+	Uint64 start = realTimeNs();
+	Uint64 end = start + (Uint64) (1e9 / TURBO_DRAW_RATE);
+
+	double start_simulation_time = getSimulationTime();
+
+	int steps = 0;
+
+	do
+	{
+		moveBodies(bodies, bodies_number, getBody(ship_handle), input, thrust);
+
+		++SimulationFrameIndex;
+		++steps;
+
+		checkDeterminism(bodies, bodies_number);
+
+		sampleTrails(bodies, bodies_number);
+
+		if (Target >= 0. && getSimulationTime() >= Target)
+		{
+			stopTurbo();
+			break;
+		}
+	}
+	while (realTimeNs() < end);
+
+	double elapsed = (realTimeNs() - start) / 1e9;
+
+	Rate = elapsed == 0. ? 0. : (getSimulationTime() - start_simulation_time) / elapsed;
+
+	return steps;
+}
+
+
+// Returns the achieved number of simulated seconds per real second, over the last fast-forward batch:
+double getTurboRate(void)
+{
+	return Rate;
+}
@@ -0,0 +1,37 @@
+#ifndef TURBO_H
+#define TURBO_H
+
+
+#include "bodies.h"
+#include "user_inputs.h"
+
+
+extern int RenderScene;
+extern unsigned int SimulationFrameIndex;
+
+
+// Fast-forward mode: physics steps are run back-to-back, without any waiting, while the scene is drawn
+// and inputs are polled only TURBO_DRAW_RATE times per second.
+
+
+void toggleTurbo(void);
+
+
+// Fast-forwards until the given simulation time, in seconds. Fast-forward then stops by itself.
+void setTurboTarget(double simulation_time);
+
+
+int isTurboOn(void);
+
+
+// Runs physics steps back-to-back for 1 / TURBO_DRAW_RATE second of real time, or until the target
+// simulation time is reached. Returns the number of steps done. The ship is looked up before each step,
+// for it may have been absorbed by the previous one.
+int runTurbo(Body **bodies, int bodies_number, BodyHandle ship_handle, Input *input, double thrust);
+
+
+// Returns the achieved number of simulated seconds per real second, over the last fast-forward batch:
+double getTurboRate(void);
+
+
+#endif
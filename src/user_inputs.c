@@ -4,124 +4,268 @@
 #include "user_inputs.h"
 #include "camera.h"
 #include "physics.h"
+#include "drawing.h"
+#include "trails.h"
+#include "turbo.h"
 
 
-static SDL_Keycode last_pressed_key;
-static int key_still_down = 0; // must start with 0.
+#define MAX_TAPS 16 // Maximum number of key presses remembered per frame.
+
 
 static char keynamesBuffer[1000];
 
+// Keys pressed since the last frame. Held keys act for at least one frame, even if released before it:
+static SDL_Scancode Taps[MAX_TAPS];
+static int TapsNumber = 0;
+
+// Input-to-present latency, measured with the SDL events timestamps, in ms:
+static int InputPending = 0;
+static Uint32 PendingInputTime = 0; // Timestamp of the oldest input not presented yet.
+static Uint32 LatencyMax = 0;
+static double LatencySum = 0.;
+static unsigned int LatencyCount = 0;
+
 
-// Main function for handling user inputs:
-void input_control(Input *input, int bodies_number)
+// Supported hotkeys, for printing them:
+static const struct
 {
-	SDL_Event event; // Better to not declare it as static, causes bugs...
+	SDL_Keycode Key;
+	const char *Description;
+} Hotkeys[] =
+{
+	{QUIT_KEY, "Quit"},
+	{PAUSE_KEY, "Pause"},
+	{TOGGLE_DRAWING_ALL_NAMES, "Toggle drawing names"},
+	{TOGGLE_TRAILS_KEY, "Toggle drawing trails"},
+	{TOGGLE_COLLISIONS_KEY, "Toggle collisions"},
+	{CAMERA_UP, "Camera up"},
+	{CAMERA_DOWN, "Camera down"},
+	{CAMERA_LEFT, "Camera left"},
+	{CAMERA_RIGHT, "Camera right"},
+	{CAMERA_FOLLOW, "Camera toggle following"},
+	{CAMERA_NEXT_TARGET, "Camera next target"},
+	{CAMERA_PREVIOUS_TARGET, "Camera previous target"},
+	{SLOW_DOWN_TIME, "Slow down time"},
+	{SPEED_UP_TIME, "Speed up time"},
+	{TOGGLE_TURBO_KEY, "Toggle fast-forward"},
+	{MOVE_UP_KEY, "Move up"},
+	{MOVE_DOWN_KEY, "Move down"},
+	{MOVE_LEFT_KEY, "Move left"},
+	{MOVE_RIGHT_KEY, "Move right"}
+};
+
+static const int HotkeysNumber = ARRAY_SIZE(Hotkeys);
+
+
+// Keys having an effect as long as they are held:
+static const SDL_Keycode HeldKeys[] =
+{
+	CAMERA_UP, CAMERA_DOWN, CAMERA_LEFT, CAMERA_RIGHT,
+	MOVE_UP_KEY, MOVE_DOWN_KEY, MOVE_LEFT_KEY, MOVE_RIGHT_KEY
+};
 
-	while (SDL_PollEvent(&event)) {} // 'while' in order to empty the event list (nails the mouse motion bug).
-	// Nota Bene: SDL_PollEvent() implicitly calls SDL_PumpEvents().
+static const int HeldKeysNumber = ARRAY_SIZE(HeldKeys);
 
-	if (event.type == SDL_QUIT || Keyboard_state[SDL_GetScancodeFromKey(QUIT_KEY)])
-	{
-		Quit = 1;
-		return;
-	}
 
-	else if (key_still_down) // Nothing happens if the last key is still down.
-	{
-		if (!Keyboard_state[SDL_GetScancodeFromKey(last_pressed_key)])
-			key_still_down = 0;
-		else
-			return;
-	}
+// Returns 1 if the given key is down, or has been pressed since the last frame:
+static int isKeyDown(SDL_Keycode key)
+{
+	SDL_Scancode scancode = SDL_GetScancodeFromKey(key);
 
-	// Pausing/unpausing the simulation:
+	if (Keyboard_state[scancode])
+		return 1;
 
-	if (key_pressed(PAUSE_KEY)) // no repeat
+	for (int i = 0; i < TapsNumber; ++i)
 	{
-		SimulationRunning = !SimulationRunning;
-		RenderScene = 1; // For drawing the pause message.
+		if (Taps[i] == scancode)
+			return 1;
 	}
 
-	// Toggling the drawing of all bodies name:
+	return 0;
+}
 
-	if (key_pressed(TOGGLE_DRAWING_ALL_NAMES)) // no repeat
-	{
-		DrawAllNames = !DrawAllNames;
-		RenderScene = 1; // For drawing the dedicated message.
-	}
 
-	// Toggling collisions:
+// Remembers the time of the oldest input not presented yet:
+static void noteInput(Uint32 timestamp)
+{
+	if (InputPending)
+		return;
 
-	if (key_pressed(TOGGLE_COLLISIONS_KEY)) // no repeat
-	{
-		CollisionsEnabled = !CollisionsEnabled;
-		RenderScene = 1; // For drawing the collision message.
-	}
+	InputPending = 1;
+	PendingInputTime = timestamp;
+}
 
-	// Camera movement. Note: calling moveCamera() sets RenderScene to 1.
 
-	if (event.type == SDL_MOUSEWHEEL && event.wheel.y != 0)
-	{
-		if (event.wheel.y > 0)
-			moveCamera(CAMERA_ZOOM, 0., 0.);
+// Follows the body at the given shift in the bodies array from the followed one:
+static void changeFollowedBody(Body **bodies, int bodies_number, int shift)
+{
+	if (bodies_number <= 0)
+		return;
 
-		else if (event.wheel.y < 0)
-			moveCamera(1. / CAMERA_ZOOM, 0., 0.);
+	int index = findBodyIndex(bodies, bodies_number, getBody(FollowedBody));
 
-		else
-			printf("Unsupported mousewheel input.\n");
-	}
+	index = index < 0 ? 0 : (index + bodies_number + shift) % bodies_number;
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(CAMERA_UP)])
-	{
-		moveCamera(1., 0, -1);
-	}
+	FollowedBody = getBodyHandle(bodies[index]);
+	RenderScene = 1;
+}
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(CAMERA_DOWN)])
-	{
-		moveCamera(1., 0, 1);
-	}
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(CAMERA_LEFT)])
+// Hotkeys acting once per key press:
+static void handleKeyPress(SDL_Keycode key, Body **bodies, int bodies_number)
+{
+	switch (key)
 	{
-		moveCamera(1., -1, 0);
+		case QUIT_KEY:
+			Quit = 1;
+			break;
+
+		// Pausing/unpausing the simulation:
+		case PAUSE_KEY:
+			SimulationRunning = !SimulationRunning;
+			RenderScene = 1; // For drawing the pause message.
+			break;
+
+		// Toggling the drawing of all bodies name:
+		case TOGGLE_DRAWING_ALL_NAMES:
+			DrawAllNames = !DrawAllNames;
+			RenderScene = 1; // For drawing the dedicated message.
+			break;
+
+		// Toggling the drawing of orbit trails. They are recorded only while drawn:
+		case TOGGLE_TRAILS_KEY:
+			DrawTrails = !DrawTrails;
+			clearTrails();
+			RenderScene = 1;
+			break;
+
+		// Toggling collisions:
+		case TOGGLE_COLLISIONS_KEY:
+			CollisionsEnabled = !CollisionsEnabled;
+			RenderScene = 1; // For drawing the collision message.
+			break;
+
+		case CAMERA_FOLLOW:
+			CameraFollowing = !CameraFollowing;
+			RenderScene = 1;
+			break;
+
+		case CAMERA_NEXT_TARGET:
+			if (CameraFollowing)
+				changeFollowedBody(bodies, bodies_number, 1);
+			break;
+
+		case CAMERA_PREVIOUS_TARGET:
+			if (CameraFollowing)
+				changeFollowedBody(bodies, bodies_number, -1);
+			break;
+
+		// Modifying the simulation speed:
+		case SLOW_DOWN_TIME:
+			changeSimulationSpeed(1. / TIME_SCALE_MULTIPLIER);
+			RenderScene = 1; // For drawing the timescale update.
+			break;
+
+		case SPEED_UP_TIME:
+			changeSimulationSpeed(TIME_SCALE_MULTIPLIER);
+			RenderScene = 1; // For drawing the timescale update.
+			break;
+
+		// Fast-forward, physics being run as fast as possible:
+		case TOGGLE_TURBO_KEY:
+			toggleTurbo();
+			RenderScene = 1;
+			break;
+
+		default:
+			break;
 	}
+}
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(CAMERA_RIGHT)])
-	{
-		moveCamera(1., 1, 0);
-	}
 
-	if (key_pressed(CAMERA_FOLLOW)) // no repeat
+static void handleEvent(SDL_Event *event, Body **bodies, int bodies_number)
+{
+	switch (event -> type)
 	{
-		CameraFollowing = !CameraFollowing;
-		RenderScene = 1;
+		case SDL_QUIT:
+			Quit = 1;
+			break;
+
+		// The content of render target textures has been lost:
+		case SDL_RENDER_TARGETS_RESET:
+			invalidateHUD();
+			RenderScene = 1;
+			break;
+
+		// e.g. the window has been exposed or resized:
+		case SDL_WINDOWEVENT:
+			RenderScene = 1;
+			break;
+
+		// Zooming. Note: calling moveCamera() sets RenderScene to 1.
+		case SDL_MOUSEWHEEL:
+			if (event -> wheel.y != 0)
+			{
+				noteInput(event -> wheel.timestamp);
+				moveCamera(event -> wheel.y > 0 ? CAMERA_ZOOM : 1. / CAMERA_ZOOM, 0., 0.);
+			}
+			break;
+
+		case SDL_KEYDOWN:
+			if (event -> key.repeat)
+				break;
+
+			noteInput(event -> key.timestamp);
+
+			if (TapsNumber < MAX_TAPS)
+				Taps[TapsNumber++] = event -> key.keysym.scancode;
+
+			handleKeyPress(event -> key.keysym.sym, bodies, bodies_number);
+			break;
+
+		default:
+			break;
 	}
+}
+
+
+// Main function for handling user inputs. Every pending event is processed. If 'timeout' is positive,
+// this first blocks until an event arrives, for at most 'timeout' ms.
+void input_control(Input *input, Body **bodies, int bodies_number, int timeout)
+{
+	SDL_Event event; // Better to not declare it as static, causes bugs...
+
+	TapsNumber = 0;
+
+	if (timeout > 0 && SDL_WaitEventTimeout(&event, timeout))
+		handleEvent(&event, bodies, bodies_number);
+
+	while (SDL_PollEvent(&event)) // Nota Bene: SDL_PollEvent() implicitly calls SDL_PumpEvents().
+		handleEvent(&event, bodies, bodies_number);
 
-	if (key_pressed(CAMERA_NEXT_TARGET) && CameraFollowing) // no repeat
+	if (Quit)
+		return;
+
+	// Camera movement. Note: calling moveCamera() sets RenderScene to 1.
+
+	if (isKeyDown(CAMERA_UP))
 	{
-		IndexFollowedBody = (IndexFollowedBody + 1) % bodies_number;
-		RenderScene = 1;
+		moveCamera(1., 0, -1);
 	}
 
-	if (key_pressed(CAMERA_PREVIOUS_TARGET) && CameraFollowing) // no repeat
+	if (isKeyDown(CAMERA_DOWN))
 	{
-		IndexFollowedBody = (IndexFollowedBody + bodies_number - 1) % bodies_number;
-		RenderScene = 1;
+		moveCamera(1., 0, 1);
 	}
 
-	// Modifying the simulation speed:
-
-	if (key_pressed(SLOW_DOWN_TIME)) // no repeat
+	if (isKeyDown(CAMERA_LEFT))
 	{
-		changeSimulationSpeed(1. / TIME_SCALE_MULTIPLIER);
-		RenderScene = 1; // For drawing the timescale update.
+		moveCamera(1., -1, 0);
 	}
 
-	if (key_pressed(SPEED_UP_TIME)) // no repeat
+	if (isKeyDown(CAMERA_RIGHT))
 	{
-		changeSimulationSpeed(TIME_SCALE_MULTIPLIER);
-		RenderScene = 1; // For drawing the timescale update.
+		moveCamera(1., 1, 0);
 	}
 
 	// Moving a spaceship:
@@ -130,40 +274,65 @@ void input_control(Input *input, int bodies_number)
 	input -> Xinput = X_NO_INPUT;
 	input -> Yinput = Y_NO_INPUT;
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(MOVE_UP_KEY)])
+	if (isKeyDown(MOVE_UP_KEY))
 	{
 		input -> Yinput += UP;
 	}
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(MOVE_DOWN_KEY)])
+	if (isKeyDown(MOVE_DOWN_KEY))
 	{
 		input -> Yinput += DOWN;
 	}
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(MOVE_LEFT_KEY)])
+	if (isKeyDown(MOVE_LEFT_KEY))
 	{
 		input -> Xinput += LEFT;
 	}
 
-	if (Keyboard_state[SDL_GetScancodeFromKey(MOVE_RIGHT_KEY)])
+	if (isKeyDown(MOVE_RIGHT_KEY))
 	{
 		input -> Xinput += RIGHT;
 	}
 }
 
 
-// Returns 1 if the given key is actually pressed, and if so updates 'last_pressed_key' and 'key_still_down'.
-int key_pressed(SDL_Keycode key)
+// Returns 1 if a key acting as long as it is held is down, in which case frames must keep coming:
+int isInputHeld(void)
 {
-	if (Keyboard_state[SDL_GetScancodeFromKey(key)])
+	for (int i = 0; i < HeldKeysNumber; ++i)
 	{
-		last_pressed_key = key;
-		key_still_down = 1;
-		return 1;
+		if (isKeyDown(HeldKeys[i]))
+			return 1;
 	}
 
-	else
-		return 0;
+	return 0;
+}
+
+
+// To be called right after a frame has been presented, for measuring the input-to-present latency:
+void inputPresented(void)
+{
+	if (!InputPending)
+		return;
+
+	Uint32 latency = SDL_GetTicks() - PendingInputTime;
+
+	LatencySum += latency;
+	LatencyMax = MAX(LatencyMax, latency);
+	++LatencyCount;
+
+	InputPending = 0;
+}
+
+
+// Prints the mean and max input-to-present latency in the console:
+void printInputLatency(void)
+{
+	if (LatencyCount == 0)
+		return;
+
+	printf("Input to present latency: mean %.1f ms, max %u ms (%u inputs)\n",
+		LatencySum / LatencyCount, LatencyMax, LatencyCount);
 }
 
 
@@ -172,36 +341,14 @@ static void initKeynamesBuffer(void)
 	if (keynamesBuffer[0] != '\0')
 		return;
 
-	char keynamesArray[17][25]; // 17: numbers of supported hotkeys.
-	// 25: maximum name length of an hotkey. What follows is due to
-	// a limitation of the SDL_GetKeyName() function, which uses a
-	// unique buffer for every key...
-
-	sprintf(keynamesArray[ 0], "%s", SDL_GetKeyName(QUIT_KEY));
-	sprintf(keynamesArray[ 1], "%s", SDL_GetKeyName(PAUSE_KEY));
-	sprintf(keynamesArray[ 2], "%s", SDL_GetKeyName(TOGGLE_DRAWING_ALL_NAMES));
-	sprintf(keynamesArray[ 3], "%s", SDL_GetKeyName(TOGGLE_COLLISIONS_KEY));
-	sprintf(keynamesArray[ 4], "%s", SDL_GetKeyName(CAMERA_UP));
-	sprintf(keynamesArray[ 5], "%s", SDL_GetKeyName(CAMERA_DOWN));
-	sprintf(keynamesArray[ 6], "%s", SDL_GetKeyName(CAMERA_LEFT));
-	sprintf(keynamesArray[ 7], "%s", SDL_GetKeyName(CAMERA_RIGHT));
-	sprintf(keynamesArray[ 8], "%s", SDL_GetKeyName(CAMERA_FOLLOW));
-	sprintf(keynamesArray[ 9], "%s", SDL_GetKeyName(CAMERA_NEXT_TARGET));
-	sprintf(keynamesArray[10], "%s", SDL_GetKeyName(CAMERA_PREVIOUS_TARGET));
-	sprintf(keynamesArray[11], "%s", SDL_GetKeyName(SLOW_DOWN_TIME));
-	sprintf(keynamesArray[12], "%s", SDL_GetKeyName(SPEED_UP_TIME));
-	sprintf(keynamesArray[13], "%s", SDL_GetKeyName(MOVE_UP_KEY));
-	sprintf(keynamesArray[14], "%s", SDL_GetKeyName(MOVE_DOWN_KEY));
-	sprintf(keynamesArray[15], "%s", SDL_GetKeyName(MOVE_LEFT_KEY));
-	sprintf(keynamesArray[16], "%s", SDL_GetKeyName(MOVE_RIGHT_KEY));
-
-	sprintf(keynamesBuffer, "Quit: %s\nPause: %s\nToggle drawing names: %s\nToggle collisions: %s\n"
-		"Camera up: %s arrow\nCamera down: %s arrow\nCamera left: %s arrow\nCamera right: %s arrow\n"
-		"Camera toggle following: %s\nCamera next target: %s\nCamera previous target: %s\nSlow down time: %s\n"
-		"Speed up time: %s\nMove up: %s\nMove down: %s\nMove left: %s\nMove right: %s\n",
-		keynamesArray[0], keynamesArray[1], keynamesArray[2], keynamesArray[3], keynamesArray[4], keynamesArray[5],
-		keynamesArray[6], keynamesArray[7], keynamesArray[8], keynamesArray[9], keynamesArray[10], keynamesArray[11],
-		keynamesArray[12], keynamesArray[13], keynamesArray[14], keynamesArray[15], keynamesArray[16]);
+	int length = 0;
+
+	// SDL_GetKeyName() uses a unique buffer for every key, hence each name is copied right away:
+	for (int i = 0; i < HotkeysNumber; ++i)
+	{
+		length += snprintf(keynamesBuffer + length, sizeof(keynamesBuffer) - length, "%s: %s\n",
+			Hotkeys[i].Description, SDL_GetKeyName(Hotkeys[i].Key));
+	}
 }
 
 
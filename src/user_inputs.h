@@ -3,6 +3,7 @@
 
 
 #include "SDLA.h"
+#include "bodies.h"
 
 
 typedef enum {X_NO_INPUT = 0, LEFT = -1, RIGHT = 1} XaxisInput;
@@ -21,17 +22,27 @@ extern int Quit;
 extern int RenderScene;
 extern int SimulationRunning;
 extern int CameraFollowing;
-extern int IndexFollowedBody;
+extern BodyHandle FollowedBody;
 extern int DrawAllNames;
+extern int DrawTrails;
 extern int CollisionsEnabled;
 
 
-// Main function for handling user inputs:
-void input_control(Input *input, int bodies_number);
+// Main function for handling user inputs. Every pending event is processed. If 'timeout' is positive,
+// this first blocks until an event arrives, for at most 'timeout' ms.
+void input_control(Input *input, Body **bodies, int bodies_number, int timeout);
 
 
-// Returns 1 if the given key is actually pressed, and if so updates 'last_pressed_key' and 'key_still_down'.
-int key_pressed(SDL_Keycode key);
+// Returns 1 if a key acting as long as it is held is down, in which case frames must keep coming:
+int isInputHeld(void);
+
+
+// To be called right after a frame has been presented, for measuring the input-to-present latency:
+void inputPresented(void);
+
+
+// Prints the mean and max input-to-present latency in the console:
+void printInputLatency(void);
 
 
 // Prints the supported hotkeys in the console: